@@ -0,0 +1,382 @@
+//===- include/uri/grammar.hpp ----------------------------*- mode: C++ -*-===//
+//*                                                  *
+//*   __ _ _ __ __ _ _ __ ___  _ __ ___   __ _ _ __  *
+//*  / _` | '__/ _` | '_ ` _ \| '_ ` _ \ / _` | '__| *
+//* | (_| | | | (_| | | | | | | | | | | | (_| | |    *
+//*  \__, |_|  \__,_|_| |_| |_|_| |_| |_|\__,_|_|    *
+//*  |___/                                           *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file grammar.hpp
+/// \brief Compile-time combinators for ABNF grammars.
+///
+/// This is a companion to the rule class in which each production is a type
+/// rather than a function which builds rule objects at run time. Because the
+/// whole grammar is visible to the compiler as a type, it can be inlined into
+/// straight-line code with no allocation and no indirect calls.
+///
+/// For example, `scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )` becomes:
+///
+/// ~~~cpp
+/// using scheme = grammar::seq<
+///   grammar::alpha,
+///   grammar::star<grammar::alt<grammar::alpha, grammar::digit,
+///                              grammar::one<'+', '-', '.'>>>>;
+/// ~~~
+///
+/// A production is a type with a static member function:
+///
+/// ~~~cpp
+/// template <typename Context>
+/// static constexpr std::size_t match (std::string_view in, Context& ctx);
+/// ~~~
+///
+/// which returns the number of characters of \p in that it matches or
+/// grammar::no_match. The context is passed to any actions in the grammar.
+///
+/// Just like the rule class, star() is greedy and alt() takes the first
+/// alternative that matches. Unlike rule, an action runs as soon as its
+/// production matches, even if an enclosing production later fails.
+///
+/// A production can be used in a rule chain with grammar::as_rule. A
+/// production wrapped in grammar::named<> is then reported to the rule's
+/// furthest_failure record and to the trace counters just as though it were
+/// a rule production passed to rule::matched().
+#ifndef URI_GRAMMAR_HPP
+#define URI_GRAMMAR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "uri/rule.hpp"
+#include "uri/trace.hpp"
+
+namespace uri::grammar {
+
+/// The value returned by a production which fails to match.
+inline constexpr auto no_match = std::numeric_limits<std::size_t>::max ();
+
+/// The context used when a production is matched without one.
+struct no_context {};
+
+// reporter
+// ~~~~~~~~
+/// The context used by as_rule when the results of matching are to be
+/// reported: to the rule's furthest_failure record and, if the library is
+/// built with URI_TRACE and counting is enabled, to the trace counters. A
+/// character class reports the position at which it fails and a named
+/// production reports its result under its name.
+class reporter {
+public:
+  explicit reporter (rule const& r) noexcept : failure_{r.failure_} {}
+
+  /// Returns true if there is anything to report to.
+  [[nodiscard]] bool active () const noexcept {
+#if URI_TRACE
+    if (trace::enabled ()) {
+      return true;
+    }
+#endif
+    return failure_ != nullptr;
+  }
+  /// Notes that a match failed at \p pos.
+  void failed_at (char const* const pos) const noexcept {
+    if (failure_ != nullptr) {
+      failure_->fail (pos);
+    }
+  }
+  /// Notes that the production \p name matched \p length characters of
+  /// \p in, or failed if \p length is no_match.
+  void matched (char const* const name, std::string_view const in,
+                std::size_t const length) const {
+#if URI_TRACE
+    if (trace::enabled ()) {
+      trace::details::record (name, length != no_match,
+                              length != no_match ? length : 0U);
+    }
+#endif
+    if (length == no_match && failure_ != nullptr) {
+      failure_->fail (name, in.data ());
+    }
+  }
+
+private:
+  furthest_failure* failure_;
+};
+
+template <typename Context>
+inline constexpr bool is_reporter =
+  std::is_same_v<std::remove_const_t<Context>, reporter>;
+
+// char class
+// ~~~~~~~~~~
+/// A production which matches a single character for which Test::test()
+/// returns true.
+template <typename Test>
+struct char_class {
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) noexcept {
+    if (!in.empty () && Test::test (in.front ())) {
+      return std::size_t{1};
+    }
+    if constexpr (is_reporter<Context>) {
+      ctx.failed_at (in.data ());
+    }
+    (void)ctx;  // Unused unless reporting.
+    return no_match;
+  }
+};
+
+/// Matches the character \p C.
+template <char C>
+struct ch : char_class<ch<C>> {
+  static constexpr bool test (char const c) noexcept { return c == C; }
+};
+
+/// Matches any one of the characters \p Cs.
+template <char... Cs>
+struct one : char_class<one<Cs...>> {
+  static constexpr bool test (char const c) noexcept {
+    return ((c == Cs) || ...);
+  }
+};
+
+/// Matches a character in the range [First, Last].
+template <char First, char Last>
+struct range : char_class<range<First, Last>> {
+  static_assert (First <= Last);
+  static constexpr bool test (char const c) noexcept {
+    return c >= First && c <= Last;
+  }
+};
+
+/// Matches any character.
+struct any : char_class<any> {
+  static constexpr bool test (char) noexcept { return true; }
+};
+
+// ALPHA = %x41-5A / %x61-7A   ; A-Z / a-z
+struct alpha : char_class<alpha> {
+  static constexpr bool test (char const c) noexcept {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+  }
+};
+// DIGIT = %x30-39   ; 0-9
+struct digit : char_class<digit> {
+  static constexpr bool test (char const c) noexcept {
+    return c >= '0' && c <= '9';
+  }
+};
+// HEXDIG = DIGIT / "A" / "B" / "C" / "D" / "E" / "F"
+//
+// (As with any ABNF quoted string, the letters are case-insensitive.)
+struct hexdig : char_class<hexdig> {
+  static constexpr bool test (char const c) noexcept {
+    return digit::test (c) || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+  }
+};
+
+// seq
+// ~~~
+/// Concatenation: matches each of \p Productions in turn.
+template <typename... Productions>
+struct seq {
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) {
+    auto length = std::size_t{0};
+    auto const step = [&] (auto const l) {
+      if (l == no_match) {
+        return false;
+      }
+      length += l;
+      return true;
+    };
+    (void)step;  // Unused if there are no productions.
+    return (step (Productions::match (in.substr (length), ctx)) && ...)
+             ? length
+             : no_match;
+  }
+};
+
+// alt
+// ~~~
+/// Alternation: matches the first of \p Productions which matches.
+template <typename... Productions>
+struct alt {
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) {
+    auto result = no_match;
+    static_cast<void> (
+      (((result = Productions::match (in, ctx)) != no_match) || ...));
+    return result;
+  }
+};
+
+// rep
+// ~~~
+/// Variable repetition (`<Min>*<Max>Production`): matches \p Production as
+/// many times as it can up to \p Max times. Fails if there are fewer than
+/// \p Min matches. Stops if \p Production matches the empty string.
+template <unsigned Min, unsigned Max, typename Production>
+struct rep {
+  static_assert (Min <= Max);
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) {
+    auto length = std::size_t{0};
+    auto count = 0U;
+    for (; count < Max; ++count) {
+      auto const l = Production::match (in.substr (length), ctx);
+      if (l == no_match) {
+        break;
+      }
+      length += l;
+      if (l == 0U) {
+        count = std::max (count + 1U, Min);
+        break;
+      }
+    }
+    return count >= Min ? length : no_match;
+  }
+};
+
+/// `*Production`
+template <typename Production>
+using star = rep<0U, std::numeric_limits<unsigned>::max (), Production>;
+/// `1*Production`
+template <typename Production>
+using plus = rep<1U, std::numeric_limits<unsigned>::max (), Production>;
+/// `[Production]`
+template <typename Production>
+using opt = rep<0U, 1U, Production>;
+
+// not at
+// ~~~~~~
+/// A negative lookahead: matches the empty string if \p Production does not
+/// match.
+template <typename Production>
+struct not_at {
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) {
+    return Production::match (in, ctx) == no_match ? std::size_t{0}
+                                                   : no_match;
+  }
+};
+
+// action
+// ~~~~~~
+/// Matches \p Production and, if successful, calls `Action{}(str, ctx)` where
+/// str is the matched string and ctx is the context.
+template <typename Production, typename Action>
+struct action {
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) {
+    auto const l = Production::match (in, ctx);
+    if (l != no_match) {
+      Action{}(in.substr (0, l), ctx);
+    }
+    return l;
+  }
+};
+
+// named
+// ~~~~~
+/// Matches \p Production. When matched by as_rule with a reporter, the result
+/// is reported under \p Name. For example:
+///
+/// ~~~cpp
+/// constexpr char pct_encoded_name[] = "pct-encoded";
+/// using pct_encoded = grammar::named<
+///   pct_encoded_name,
+///   grammar::seq<grammar::ch<'%'>, grammar::hexdig, grammar::hexdig>>;
+/// ~~~
+template <char const* Name, typename Production>
+struct named {
+  template <typename Context>
+  static constexpr std::size_t match (std::string_view const in,
+                                      Context& ctx) {
+    auto const l = Production::match (in, ctx);
+    if constexpr (is_reporter<Context>) {
+      ctx.matched (Name, in, l);
+    }
+    return l;
+  }
+};
+
+// prefix
+// ~~~~~~
+/// Returns the prefix of \p in matched by \p Production or nullopt if it does
+/// not match.
+template <typename Production, typename Context>
+constexpr std::optional<std::string_view> prefix (std::string_view const in,
+                                                  Context& ctx) {
+  if (auto const l = Production::match (in, ctx); l != no_match) {
+    return in.substr (0, l);
+  }
+  return std::nullopt;
+}
+template <typename Production>
+constexpr std::optional<std::string_view> prefix (std::string_view const in) {
+  no_context ctx;
+  return prefix<Production> (in, ctx);
+}
+
+// full
+// ~~~~
+/// Returns true if \p Production matches the whole of \p in.
+template <typename Production, typename Context>
+constexpr bool full (std::string_view const in, Context& ctx) {
+  return Production::match (in, ctx) == in.size ();
+}
+template <typename Production>
+constexpr bool full (std::string_view const in) {
+  no_context ctx;
+  return full<Production> (in, ctx);
+}
+
+// as rule
+// ~~~~~~~
+/// A function object which matches \p Production in a rule chain. The
+/// production is matched with a reporter only if there is something to report
+/// to so that an ordinary parse pays for a single test.
+template <typename Production>
+struct rule_adapter {
+  rule::matched_result operator() (rule const& r) const {
+    if (auto const tail = r.tail ()) {
+      std::optional<std::string_view> m;
+      if (reporter ctx{r}; ctx.active ()) {
+        m = prefix<Production> (*tail, ctx);
+      } else {
+        m = prefix<Production> (*tail);
+      }
+      if (m) {
+        return std::make_tuple (*m, rule::acceptor_container{});
+      }
+    }
+    return {};
+  }
+};
+/// Enables \p Production to be used with the rule class. For example:
+///
+/// ~~~cpp
+/// r.concat (grammar::as_rule<scheme>, [] (std::string_view s) { ... })
+/// ~~~
+template <typename Production>
+inline constexpr auto as_rule = rule_adapter<Production>{};
+
+}  // end namespace uri::grammar
+
+#endif  // URI_GRAMMAR_HPP
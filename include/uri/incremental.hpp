@@ -0,0 +1,167 @@
+//===- include/uri/incremental.hpp ------------------------*- mode: C++ -*-===//
+//*  _                                          _        _  *
+//* (_)_ __   ___ _ __ ___ _ __ ___   ___ _ __ | |_ __ _| | *
+//* | | '_ \ / __| '__/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | | *
+//* | | | | | (__| | |  __/ | | | | |  __/ | | | || (_| | | *
+//* |_|_| |_|\___|_|  \___|_| |_| |_|\___|_| |_|\__\__,_|_| *
+//*                                                         *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file incremental.hpp
+/// \brief A URI parser which accepts its input in pieces.
+///
+/// uri::split() needs the whole of a URI before it can begin. A server which
+/// reads a request target from the network receives it in arbitrary chunks and
+/// would rather not wait for (or buffer) an entire target before rejecting it.
+/// The incremental_parser class accepts the input one chunk at a time: each
+/// byte is examined as it arrives and is never scanned again, a component is
+/// reported as soon as its last byte has been seen, and input which cannot be
+/// the start of a valid URI-reference, or which exceeds a length limit, is
+/// rejected at the first offending byte. (The one exception is a host which
+/// might be an IP address: it is checked as a whole once it is complete.)
+///
+/// ~~~cpp
+/// uri::incremental_parser p{[] (auto component, std::string_view value) {
+///   // ...
+/// }};
+/// while (...) {
+///   if (!p.feed (chunk)) {
+///     // Reject the input without reading any more of it.
+///   }
+/// }
+/// std::optional<uri::parts> const result = p.finish ();
+/// ~~~
+///
+/// The parser accepts exactly the same language as uri::split() and produces
+/// identical results.
+#ifndef URI_INCREMENTAL_HPP
+#define URI_INCREMENTAL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "uri/uri.hpp"
+
+namespace uri {
+
+class incremental_parser {
+public:
+  /// The components reported to the callback.
+  enum class component : std::uint8_t {
+    scheme,
+    userinfo,
+    host,
+    port,
+    segment,  ///< A path segment.
+    query,
+    fragment,
+  };
+  /// The type of the function which is called as each component is completed.
+  /// The string_view is only valid until the next call to feed().
+  using callback = std::function<void (component, std::string_view)>;
+
+  /// The default input limit. This matches the request line limit commonly
+  /// used by HTTP servers.
+  static constexpr auto default_max_length = std::size_t{8192};
+
+  explicit incremental_parser (callback cb = callback{},
+                               std::size_t max_length = default_max_length);
+
+  /// Consumes the next chunk of input.
+  ///
+  /// \param chunk  The next part of the input.
+  /// \returns False if the input seen so far cannot be the start of a valid
+  ///   URI-reference or is longer than the limit passed to the constructor.
+  ///   Once it has returned false, the parser rejects any further input.
+  bool feed (std::string_view chunk);
+
+  /// Signals the end of the input.
+  ///
+  /// \returns The components of the input or std::nullopt if it is not a
+  ///   valid URI-reference. The string_views in the result refer to storage
+  ///   owned by the parser and are valid until it is reset or destroyed.
+  std::optional<parts> finish ();
+
+  /// Discards the input and returns the parser to its initial state so that
+  /// it may be used again.
+  void reset ();
+
+  /// Returns true if the parser has rejected its input.
+  [[nodiscard]] constexpr bool failed () const noexcept {
+    return state_ == state::failed;
+  }
+  /// Returns the number of bytes that have been consumed.
+  [[nodiscard]] std::size_t size () const noexcept { return input_.size (); }
+
+private:
+  enum class state : std::uint8_t {
+    start,          ///< No input has been seen.
+    scheme,         ///< A scheme or the first path segment of a relative-ref.
+    segment_nc,     ///< The first path segment of a relative-ref (no colon).
+    hier_part,      ///< Immediately after "scheme:".
+    solidus,        ///< After a leading "/": an authority or path-absolute.
+    authority,      ///< Inside an authority.
+    authority_end,  ///< After "]" at the end of an IP-literal.
+    segment,        ///< Inside a path segment.
+    query,
+    fragment,
+    finished,  ///< finish() has been called.
+    failed,
+  };
+  /// A component is recorded as a range of the input string rather than as a
+  /// string_view because the input may be reallocated as it grows.
+  struct span {
+    std::size_t first = 0;
+    std::size_t last = 0;
+  };
+
+  bool fail ();
+  void report (component c, span s) const;
+  void end_segment (std::size_t pos);
+  bool end_authority (std::size_t pos);
+  bool end_input ();
+  [[nodiscard]] std::string_view view (span s) const noexcept {
+    return std::string_view{input_}.substr (s.first, s.last - s.first);
+  }
+
+  callback callback_;
+  std::size_t max_length_;
+  std::string input_;
+  state state_ = state::start;
+  /// The number of hex digits needed to complete a pct-encoded triplet.
+  std::uint8_t pct_ = 0;
+
+  // The authority.
+  /// The start of the component currently being scanned.
+  std::size_t first_ = 0;
+  /// The start of the host (after any userinfo).
+  std::size_t host_first_ = 0;
+  /// The position of the most recent ":" in the host and port.
+  std::size_t colon_ = 0;
+  /// The number of colons (outside of an IP-literal) since host_first_.
+  unsigned colons_ = 0;
+  bool ip_literal_ = false;
+  /// True if every character after the most recent colon is a digit.
+  bool digits_ = true;
+
+  std::optional<span> scheme_;
+  std::optional<span> userinfo_;
+  std::optional<span> host_;
+  std::optional<span> port_;
+  bool absolute_ = false;
+  std::vector<span> segments_;
+  std::optional<span> query_;
+  std::optional<span> fragment_;
+};
+
+}  // end namespace uri
+
+#endif  // URI_INCREMENTAL_HPP
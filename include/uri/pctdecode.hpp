@@ -14,13 +14,16 @@
 #define URI_PCTDECODE_HPP
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cctype>
 #include <cstddef>
 #include <iterator>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <utility>
+#include <variant>
 
 #if __has_include(<version>)
 #include <version>
@@ -62,6 +65,21 @@ constexpr std::byte hex2dec (ValueT const digit) noexcept {
   }
   return bad;
 }
+
+/// A table mapping each of the 256 possible code units to the value produced
+/// by hex2dec(). Indexing this table avoids the branches in hex2dec().
+inline constexpr auto hex_table = [] {
+  std::array<std::byte, 256> table{};
+  for (auto c = 0U; c < table.size (); ++c) {
+    table[c] = hex2dec (c);
+  }
+  return table;
+}();
+/// Equivalent to hex2dec(c) for a code unit.
+constexpr std::byte hex_value (char const c) noexcept {
+  return hex_table[static_cast<unsigned char> (c)];
+}
+
 constexpr bool either_bad (std::byte n1, std::byte n2) noexcept {
   return ((n1 | n2) & bad) != std::byte{0};
 }
@@ -365,15 +383,211 @@ private:
 template <typename Container>
 pctdecoder (Container) -> pctdecoder<typename Container::const_iterator>;
 
-inline std::string pctdecode (std::string_view s) {
-  std::string result;
-  result.reserve (s.length ());
-  for (auto const& c : pctdecoder{s}) {
-    result += c;
+namespace details {
+
+/// A table containing each of the 256 code units. A decoded byte is presented
+/// as a one character view of this table.
+inline constexpr auto code_units = [] {
+  std::array<char, 256> table{};
+  for (auto c = 0U; c < table.size (); ++c) {
+    table[c] = static_cast<char> (c);
   }
-  return result;
+  return table;
+}();
+
+/// Returns true if \p s holds a valid escape at index \p pos.
+constexpr bool is_escape (std::string_view const s,
+                          std::size_t const pos) noexcept {
+  return s.length () - pos >= 3 && s[pos] == '%' &&
+         !either_bad (hex_value (s[pos + 1]), hex_value (s[pos + 2]));
 }
 
+}  // end namespace details
+
+/// A forward iterator which presents percent-encoded text as a series of
+/// chunks. Each chunk is either the longest run of literal characters before
+/// the next valid escape or a single decoded character. Invalid escapes are
+/// literal text, just as they are for pctdecode_iterator.
+///
+/// Each chunk is a string-view which refers either to the input or to static
+/// storage so remains valid after the iterator is incremented.
+class pctdecode_chunk_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = std::string_view;
+  using difference_type = std::ptrdiff_t;
+  using pointer = value_type const*;
+  using reference = value_type const&;
+
+  constexpr pctdecode_chunk_iterator () noexcept = default;
+  /// \param rest  The input text starting at the first chunk.
+  constexpr explicit pctdecode_chunk_iterator (std::string_view rest) noexcept
+      : rest_{rest} {
+    this->next_chunk ();
+  }
+
+  constexpr bool operator== (
+    pctdecode_chunk_iterator const& other) const noexcept {
+    return rest_.data () == other.rest_.data ();
+  }
+#if __cplusplus < 202002L
+  constexpr bool operator!= (
+    pctdecode_chunk_iterator const& other) const noexcept {
+    return !operator== (other);
+  }
+#endif
+
+  constexpr reference operator* () const noexcept { return chunk_; }
+  constexpr pointer operator->() const noexcept { return &chunk_; }
+
+  constexpr pctdecode_chunk_iterator& operator++ () noexcept {
+    rest_.remove_prefix (consumed_);
+    this->next_chunk ();
+    return *this;
+  }
+  constexpr pctdecode_chunk_iterator operator++ (int) noexcept {
+    auto const prev = *this;
+    ++(*this);
+    return prev;
+  }
+
+private:
+  constexpr void next_chunk () noexcept {
+    if (rest_.empty ()) {
+      chunk_ = std::string_view{};
+      consumed_ = 0;
+      return;
+    }
+    if (details::is_escape (rest_, 0)) {
+      auto const value = (details::hex_value (rest_[1]) << 4U) |
+                         details::hex_value (rest_[2]);
+      chunk_ = std::string_view{
+        &details::code_units[static_cast<std::size_t> (value)], 1};
+      consumed_ = 3;
+      return;
+    }
+    // A literal run extends to the next '%' which starts a valid escape.
+    auto pos = rest_.find ('%', 1);
+    while (pos != std::string_view::npos && !details::is_escape (rest_, pos)) {
+      pos = rest_.find ('%', pos + 1);
+    }
+    chunk_ = rest_.substr (0, pos);
+    consumed_ = chunk_.length ();
+  }
+
+  std::string_view rest_;   ///< The input starting at the current chunk.
+  std::string_view chunk_;  ///< The current chunk.
+  std::size_t consumed_ = 0;  ///< The number of input characters in chunk_.
+};
+
+/// A range which presents percent-encoded text as a series of chunks which
+/// can be consumed in bulk. For example:
+///
+///     std::string out;
+///     for (std::string_view chunk : uri::pctdecode_chunks{s}) {
+///       out.append (chunk);
+///     }
+///
+/// \see pctdecode_chunk_iterator
+class pctdecode_chunks {
+public:
+  constexpr pctdecode_chunks () noexcept = default;
+  constexpr explicit pctdecode_chunks (std::string_view const s) noexcept
+      : s_{s} {}
+
+  constexpr pctdecode_chunk_iterator begin () const noexcept {
+    return pctdecode_chunk_iterator{s_};
+  }
+  constexpr pctdecode_chunk_iterator end () const noexcept {
+    return pctdecode_chunk_iterator{s_.substr (s_.length ())};
+  }
+
+private:
+  std::string_view s_;
+};
+
+/// Decodes the percent-encoded string \p s. The result is the same as that
+/// produced by pctdecode_iterator but literal runs between escapes are found
+/// and copied in bulk.
+std::string pctdecode (std::string_view s);
+
+/// Decodes the percent-encoded range [first, last) in place. The decoded text
+/// is never longer than the input so it is written from \p first and a
+/// pointer to its end is returned. The contents of the range beyond that point
+/// are unspecified.
+char* pctdecode_inplace (char* first, char* last) noexcept;
+/// Decodes the string \p s in place and shrinks it to the decoded length.
+std::string& pctdecode_inplace (std::string& s);
+
+enum class pctdecode_error_code : int {
+  none,
+  bad_escape,        ///< A '%' which is not followed by two hex digits.
+  truncated_escape,  ///< A '%' with too few characters left to follow it.
+  nul,               ///< A NUL (U+0000) character.
+  bad_utf8,          ///< The decoded text is not well-formed UTF-8.
+};
+
+class pctdecode_error_category final : public std::error_category {
+public:
+  char const* name () const noexcept override;
+  std::string message (int error) const override;
+};
+std::error_code make_error_code (pctdecode_error_code e);
+
+/// The optional checks performed by pctdecode_strict().
+struct pctdecode_checks {
+  /// Reject NUL characters whether they are literal or produced by "%00".
+  bool nul = false;
+  /// Reject decoded text which is not well-formed UTF-8.
+  bool utf8 = false;
+};
+
+struct pctdecode_error {
+  std::error_code code;
+  /// The offset within the input of the first byte of the bad escape, NUL
+  /// character, or UTF-8 sequence.
+  std::size_t offset = 0;
+
+  bool operator== (pctdecode_error const& rhs) const noexcept {
+    return code == rhs.code && offset == rhs.offset;
+  }
+  bool operator!= (pctdecode_error const& rhs) const noexcept {
+    return !operator== (rhs);
+  }
+};
+
+using pctdecode_strict_result = std::variant<pctdecode_error, std::string>;
+
+/// Decodes the percent-encoded string \p s rejecting malformed escapes
+/// rather than passing them through unchanged. Validation happens in the same
+/// pass as decoding: on failure, the kind and input offset of the first error
+/// is returned.
+///
+/// \param s  The string to be decoded.
+/// \param checks  Additional checks to be made on the decoded text.
+/// \returns The decoded string or a description of the first error.
+pctdecode_strict_result pctdecode_strict (std::string_view s,
+                                          pctdecode_checks checks = {});
+
+/// Decodes the percent-encoded string \p s and checks that the result is
+/// well-formed UTF-8. Escapes are handled as they are by pctdecode(): invalid
+/// escapes are passed through unchanged. The decoded text is validated a
+/// block at a time as it is produced rather than in a second pass over the
+/// whole string.
+///
+/// \param s  The string to be decoded.
+/// \returns The decoded string or an error whose offset is that of the input
+///   character that produced the first byte of the first ill-formed UTF-8
+///   sequence.
+pctdecode_strict_result pctdecode_utf8 (std::string_view s);
+
 }  // end namespace uri
 
+#ifdef URI_PCTDECODE_RANGES
+// The chunks refer to the underlying text rather than the range object.
+template <>
+inline constexpr bool
+  std::ranges::enable_borrowed_range<uri::pctdecode_chunks> = true;
+#endif  // URI_PCTDECODE_RANGES
+
 #endif  // URI_PCTDECODE_HPP
@@ -20,6 +20,17 @@
 #include <cstdint>
 #include <iterator>
 #include <string>
+#include <string_view>
+#include <utility>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
+#include <ranges>
+#define URI_PCTENCODE_RANGES
+#endif
 
 namespace uri {
 
@@ -40,10 +51,125 @@ enum class pctencode_set : std::uint8_t {
     1U << 6U,  ///< The application/x-www-form-urlencoded percent-encode set.
 };
 
+namespace details {
+
+// For each code point from U+0021 (!) to U+007E (~), one bit for each of the
+// encode sets which contain it. The digits and latin letters are never encoded
+// and are omitted.
+inline constexpr std::array<std::uint8_t, 32> pctencode_bits{{
+  0b0100'0000,  // U+0021 EXCLAMATION MARK
+  0b0111'1111,  // U+0022 QUOTATION MARK
+  0b0111'1110,  // U+0023 NUMBER SIGN
+  0b0110'0000,  // U+0024 DOLLAR SIGN
+  0b1111'1111,  // U+0025 PERCENT SIGN
+  0b0110'0000,  // U+0026 AMPERSAND
+  0b0100'0100,  // U+0027 APOSTROPHE
+  0b0100'0000,  // U+0028 LEFT PARENTHESIS
+  0b0100'0000,  // U+0029 RIGHT PARENTHESIS
+  0b0000'0000,  // U+002A ASTERISK
+  0b0110'0000,  // U+002B PLUS SIGN
+  0b0110'0000,  // U+002C COMMA
+  0b0000'0000,  // U+002D HYPHEN MINUS
+  0b0000'0000,  // U+002E FULL STOP
+  0b0111'0000,  // U+002F SOLIDUS
+  // U+0030 DIGIT ZERO to U+0039 DIGIT NINE removed.
+  0b0111'0000,  // U+003A (:)
+  0b0111'0000,  // U+003B (;)
+  0b0111'1111,  // U+003C (<)
+  0b0111'0000,  // U+003D (=)
+  0b0111'1111,  // U+003E (>)
+  0b0111'1000,  // U+003F (?)
+  0b0111'0000,  // U+0040 (@)
+  // U+0041 LATIN CAPITAL LETTER A to U+005A LATIN CAPITAL LETTER Z removed.
+  0b0111'0000,  // U+005B ([ LEFT SQUARE BRACKET)
+  0b0111'0000,  // U+005C (\ REVERSE SOLIDUS)
+  0b0111'0000,  // U+005D (] RIGHT SWUARE BRACKET)
+  0b0111'0000,  // U+005E (^ CIRCUMFLEX ACCENT)
+  0b0000'0000,  // U+005F LOW LINE
+  0b0111'1000,  // U+0060 GRAVE ACCENT
+  // U+0061 LATIN SMALL LETTER A to U+007A LATIN SMALL LETTER Z removed.
+  0b0111'1000,  // U+007B LEFT CURLY BRACKET
+  0b0111'0000,  // U+007C VERTICAL LINE
+  0b0111'1000,  // U+007D RIGHT CURLY BRACKET
+  0b0100'0000,  // U+007E TILDE
+}};
+
+// An implementation of section 1.3 "Percent-encoded bytes"
+// https://url.spec.whatwg.org/#percent-encoded-bytes. This is used to build
+// the lookup tables below.
+constexpr bool in_pctencode_set (std::uint_least8_t c,
+                                 pctencode_set es) noexcept {
+  constexpr auto space = 0x20;
+  constexpr auto exclamation_mark = 0x21;
+  constexpr auto digit_zero = 0x30;
+  constexpr auto digit_nine = 0x39;
+  constexpr auto latin_capital_letter_a = 0x41;
+  constexpr auto latin_capital_letter_z = 0x5A;
+  constexpr auto latin_small_letter_a = 0x61;
+  constexpr auto latin_small_letter_z = 0x7A;
+  constexpr auto tilde = 0x7E;
+  constexpr auto num_digits = 10;
+  constexpr auto num_alpha = 26;
+  // Code point of the first entry in the table.
+  constexpr auto table_first = exclamation_mark;
+  constexpr auto capital_letter_adjustment = table_first + num_digits;
+  constexpr auto small_letter_adjustment = table_first + num_digits + num_alpha;
+
+  if (c <= space || c > tilde) {
+    return true;
+  }
+  c -= table_first;  // C0 control codes were removed.
+  if (c >= digit_zero - table_first) {
+    if (c <= digit_nine - table_first) {
+      return false;
+    }
+    c -= num_digits;  // The digits are missing from the table.
+  }
+  if (c >= latin_capital_letter_a - capital_letter_adjustment) {
+    if (c <= latin_capital_letter_z - capital_letter_adjustment) {
+      return false;  // A latin capital letter.
+    }
+    c -= num_alpha;  // Upper-case letters are missing from the table.
+  }
+  if (c >= latin_small_letter_a - small_letter_adjustment) {
+    if (c <= latin_small_letter_z - small_letter_adjustment) {
+      return false;  // A latin lower-case letter.
+    }
+    c -= num_alpha;  // Lower-case letters are missing.
+  }
+  if (c >= pctencode_bits.size ()) {
+    return false;
+  }
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+  return (pctencode_bits[c] &
+          static_cast<std::underlying_type_t<pctencode_set>> (es)) != 0U;
+}
+
+/// A table which is indexed by code unit and yields true if that code unit is
+/// a member of the encode set given by the template argument.
+template <pctencode_set EncodeSet>
+inline constexpr auto pctencode_table = [] {
+  std::array<bool, 256> table{};
+  for (auto c = 0U; c < table.size (); ++c) {
+    table[c] =
+      in_pctencode_set (static_cast<std::uint_least8_t> (c), EncodeSet);
+  }
+  return table;
+}();
+
+}  // end namespace details
+
 // An implementation of section 1.3 "Percent-encoded bytes"
 // https://url.spec.whatwg.org/#percent-encoded-bytes
 bool needs_pctencode (std::uint_least8_t c, pctencode_set es) noexcept;
 
+/// Returns true if code unit \p c is a member of the encode set given by the
+/// template argument. The test is a single table lookup.
+template <pctencode_set EncodeSet>
+constexpr bool needs_pctencode (std::uint_least8_t const c) noexcept {
+  return details::pctencode_table<EncodeSet>[c];
+}
+
 template <typename InputIterator>
 bool needs_pctencode (InputIterator first, InputIterator last,
                       pctencode_set es) {
@@ -53,9 +179,52 @@ bool needs_pctencode (InputIterator first, InputIterator last,
 
 bool needs_pctencode (std::string_view s, pctencode_set es);
 
+/// Percent-encodes the range [first, last) using the encode set given by the
+/// template argument. For example:
+///
+/// ~~~cpp
+/// uri::pctencode<uri::pctencode_set::path> (first, last, out);
+/// ~~~
+template <pctencode_set EncodeSet, typename InputIterator,
+          typename OutputIterator>
+OutputIterator pctencode (InputIterator first, InputIterator last,
+                          OutputIterator out) {
+  for (; first != last; ++first) {
+    auto c = *first;
+    if (needs_pctencode<EncodeSet> (static_cast<std::uint_least8_t> (c))) {
+      auto const cu = static_cast<std::make_unsigned_t<decltype (c)>> (c);
+      *(out++) = '%';
+      *(out++) = dec2hex ((cu >> 4U) & 0xFU);
+      c = dec2hex (cu & 0xFU);
+    }
+    *(out++) = c;
+  }
+  return out;
+}
+
 template <typename InputIterator, typename OutputIterator>
 OutputIterator pctencode (InputIterator first, InputIterator last,
                           OutputIterator out, pctencode_set encodeset) {
+  // Select the instantiation whose table matches the encode set so that the
+  // inner loop is a table lookup rather than a call to needs_pctencode().
+  switch (encodeset) {
+  case pctencode_set::none:
+    return pctencode<pctencode_set::none> (first, last, out);
+  case pctencode_set::fragment:
+    return pctencode<pctencode_set::fragment> (first, last, out);
+  case pctencode_set::query:
+    return pctencode<pctencode_set::query> (first, last, out);
+  case pctencode_set::special_query:
+    return pctencode<pctencode_set::special_query> (first, last, out);
+  case pctencode_set::path:
+    return pctencode<pctencode_set::path> (first, last, out);
+  case pctencode_set::userinfo:
+    return pctencode<pctencode_set::userinfo> (first, last, out);
+  case pctencode_set::component:
+    return pctencode<pctencode_set::component> (first, last, out);
+  case pctencode_set::form_urlencoded:
+    return pctencode<pctencode_set::form_urlencoded> (first, last, out);
+  }
   for (; first != last; ++first) {
     auto c = *first;
     if (needs_pctencode (static_cast<std::uint_least8_t> (c), encodeset)) {
@@ -69,13 +238,221 @@ OutputIterator pctencode (InputIterator first, InputIterator last,
   return out;
 }
 
-inline std::string pctencode (std::string_view s, pctencode_set encodeset) {
-  std::string result;
-  result.reserve (s.length ());
-  pctencode (std::begin (s), std::end (s), std::back_inserter (result),
-             encodeset);
-  return result;
+namespace details {
+
+/// Returns code unit number \p step of the encoding of \p c using the encode
+/// set \p es. If \p c is not in the encode set, step must be zero and the
+/// result is \p c itself; otherwise the steps 0, 1, and 2 produce '%' and the
+/// two hexadecimal digits.
+template <typename ValueType>
+constexpr ValueType pctencode_unit (ValueType const c, unsigned const step,
+                                    pctencode_set const es) noexcept {
+  auto const cu = static_cast<std::uint_least8_t> (c);
+  if (!in_pctencode_set (cu, es)) {
+    assert (step == 0U);
+    return c;
+  }
+  switch (step) {
+  case 0U: return '%';
+  case 1U: return static_cast<ValueType> (dec2hex ((cu >> 4U) & 0xFU));
+  default: return static_cast<ValueType> (dec2hex (cu & 0xFU));
+  }
+}
+
+}  // end namespace details
+
+/// pctencode_iterator is a forward-iterator which percent-encodes the
+/// characters of an underlying sequence on the fly. Each character which is a
+/// member of the encode set produces three characters: "%" followed by two
+/// (uppercase) hexadecimal digits. Other characters are unchanged. For
+/// example:
+///
+/// ~~~cpp
+/// std::copy (uri::pctencode_begin (s, uri::pctencode_set::path),
+///            uri::pctencode_end (s, uri::pctencode_set::path), out);
+/// ~~~
+template <typename Iterator>
+class pctencode_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename std::iterator_traits<Iterator>::value_type;
+  using difference_type = std::ptrdiff_t;
+  using pointer = value_type const*;
+  using reference = value_type const&;
+
+  constexpr pctencode_iterator () noexcept = default;
+  constexpr pctencode_iterator (Iterator pos, pctencode_set const encodeset)
+      : pos_{std::move (pos)}, encodeset_{encodeset} {}
+
+  constexpr bool operator== (pctencode_iterator const& other) const {
+    assert (encodeset_ == other.encodeset_ &&
+            "Comparing iterators with different encode sets");
+    return pos_ == other.pos_ && step_ == other.step_;
+  }
+#if __cplusplus < 202002L
+  constexpr bool operator!= (pctencode_iterator const& other) const {
+    return !operator== (other);
+  }
+#endif
+
+  /// Returns the position in the underlying sequence.
+  constexpr Iterator const& base () const noexcept { return pos_; }
+
+  reference operator* () const {
+    c_ = details::pctencode_unit (static_cast<value_type> (*pos_), step_,
+                                  encodeset_);
+    return c_;
+  }
+  pointer operator->() const { return &(**this); }
+
+  pctencode_iterator& operator++ () {
+    if (step_ == 0U && !details::in_pctencode_set (
+                         static_cast<std::uint_least8_t> (*pos_), encodeset_)) {
+      ++pos_;
+    } else if (++step_ == 3U) {
+      step_ = 0U;
+      ++pos_;
+    }
+    return *this;
+  }
+  pctencode_iterator operator++ (int) {
+    auto const prev = *this;
+    ++(*this);
+    return prev;
+  }
+
+private:
+  Iterator pos_{};
+  pctencode_set encodeset_ = pctencode_set::none;
+  /// The index of the next character of the current encoding.
+  unsigned step_ = 0;
+  mutable value_type c_ = 0;
+};
+
+template <typename Iterator>
+pctencode_iterator (Iterator, pctencode_set) -> pctencode_iterator<Iterator>;
+
+template <typename Container>
+constexpr auto pctencode_begin (Container const& c, pctencode_set const es) {
+  return pctencode_iterator{std::begin (c), es};
+}
+template <typename Container>
+constexpr auto pctencode_end (Container const& c, pctencode_set const es) {
+  return pctencode_iterator{std::end (c), es};
+}
+
+#ifdef URI_PCTENCODE_RANGES
+/// A view which percent-encodes the elements of an underlying view on the
+/// fly. Normally created using uri::views::pctencode:
+///
+/// ~~~cpp
+/// auto encoded = s | uri::views::pctencode (uri::pctencode_set::path);
+/// ~~~
+template <std::ranges::forward_range View>
+  requires std::ranges::view<View>
+class pctencode_view
+    : public std::ranges::view_interface<pctencode_view<View>> {
+  class sentinel;
+
+public:
+  using iterator = pctencode_iterator<std::ranges::iterator_t<View const>>;
+
+  pctencode_view ()
+    requires std::default_initializable<View>
+  = default;
+  constexpr pctencode_view (View base, pctencode_set const encodeset)
+      : base_{std::move (base)}, encodeset_{encodeset} {}
+
+  constexpr View base () const&
+    requires std::copy_constructible<View>
+  {
+    return base_;
+  }
+  constexpr View base () && { return std::move (base_); }
+
+  constexpr iterator begin () const {
+    return iterator{std::ranges::begin (base_), encodeset_};
+  }
+  constexpr auto end () const {
+    if constexpr (std::ranges::common_range<View const>) {
+      return iterator{std::ranges::end (base_), encodeset_};
+    } else {
+      return sentinel{std::ranges::end (base_)};
+    }
+  }
+
+private:
+  [[no_unique_address]] View base_ = View{};
+  pctencode_set encodeset_ = pctencode_set::none;
+};
+
+template <std::ranges::forward_range View>
+  requires std::ranges::view<View>
+class pctencode_view<View>::sentinel {
+public:
+  sentinel () = default;
+  constexpr explicit sentinel (std::ranges::sentinel_t<View const> end)
+      : end_{std::move (end)} {}
+
+  friend constexpr bool operator== (iterator const& x, sentinel const& y) {
+    return x.base () == y.end_;
+  }
+
+private:
+  std::ranges::sentinel_t<View const> end_{};
+};
+
+template <class Range>
+pctencode_view (Range&&, pctencode_set)
+  -> pctencode_view<std::views::all_t<Range>>;
+
+namespace details {
+
+/// The result of uri::views::pctencode(encodeset): a range adaptor closure
+/// which holds the encode set.
+struct pctencode_range_closure {
+  pctencode_set encodeset;
+
+  template <std::ranges::viewable_range Range>
+  constexpr auto operator() (Range&& r) const {
+    return pctencode_view{std::forward<Range> (r), encodeset};
+  }
+};
+
+template <std::ranges::viewable_range Range>
+constexpr auto operator| (Range&& r, pctencode_range_closure const& closure) {
+  return closure (std::forward<Range> (r));
 }
 
+struct pctencode_range_adaptor {
+  template <std::ranges::viewable_range Range>
+  constexpr auto operator() (Range&& r, pctencode_set const es) const {
+    return pctencode_view{std::forward<Range> (r), es};
+  }
+  constexpr pctencode_range_closure operator() (
+    pctencode_set const es) const noexcept {
+    return {es};
+  }
+};
+
+}  // end namespace details
+
+namespace views {
+inline constexpr auto pctencode = details::pctencode_range_adaptor{};
+}  // end namespace views
+
+#endif  // URI_PCTENCODE_RANGES
+
+/// Returns the length of the string which pctencode() will produce when
+/// encoding \p s with the encode set \p encodeset. Callers which are building
+/// a larger string can use this to reserve space ahead of time.
+std::size_t pctencoded_length (std::string_view s, pctencode_set encodeset);
+
+/// Percent-encodes the string \p s using the encode set \p encodeset. The
+/// result is allocated once at its exact length. Runs of code units which need
+/// no encoding are found a block at a time and are copied to the result in
+/// bulk.
+std::string pctencode (std::string_view s, pctencode_set encodeset);
+
 }  // namespace uri
 #endif  // URI_PCTENCODE_HPP
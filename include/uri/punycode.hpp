@@ -14,14 +14,19 @@
 #define URI_PUNYCODE_HPP
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <string>
 #include <string_view>
 #include <system_error>
 #include <tuple>
 #include <variant>
+#include <vector>
 
 namespace uri::punycode {
 
@@ -29,6 +34,7 @@ enum class decode_error_code : int {
   none,
   bad_input,
   overflow,
+  too_long,  ///< The output does not fit in the space provided.
 };
 
 class error_category final : public std::error_category {
@@ -103,50 +109,113 @@ constexpr std::string::size_type adapt (std::string::size_type delta,
 
 }  // namespace details
 
+namespace details {
+
+/// A non-basic code point and its position in the input.
+struct code_point_position {
+  char32_t cp;
+  std::uint32_t pos;
+};
+
+/// A Fenwick tree (binary indexed tree) which records a set of positions in
+/// the input and counts the members of that set before a given position in
+/// logarithmic time.
+class position_index {
+public:
+  /// \param tree  Storage for the tree which must have \p size elements, all
+  ///   zero.
+  /// \param size  The number of positions in the input.
+  constexpr position_index (std::uint32_t* const tree,
+                            std::size_t const size) noexcept
+      : tree_{tree}, size_{size} {}
+
+  /// Adds \p pos to the set.
+  constexpr void insert (std::size_t pos) noexcept {
+    for (++pos; pos <= size_; pos += pos & (~pos + 1U)) {
+      ++tree_[pos - 1U];
+    }
+  }
+  /// Returns the number of members of the set which are less than \p pos.
+  constexpr std::size_t count_before (std::size_t pos) const noexcept {
+    auto result = std::size_t{0};
+    for (; pos > 0U; pos -= pos & (~pos + 1U)) {
+      result += tree_[pos - 1U];
+    }
+    return result;
+  }
+
+private:
+  std::uint32_t* tree_;
+  std::size_t size_;
+};
+
+/// The body of encode() which is given storage for the non-basic code points
+/// and the position index (each with input.size() elements).
+///
+/// The original algorithm from RFC 3492 makes a pass over the entire input for
+/// each distinct non-basic code point. Here, the non-basic code points are
+/// sorted along with their positions so they can be visited in the order that
+/// they are encoded. The number of code points less than the current one which
+/// lie between two positions (which is what each pass over the input would
+/// have counted) comes from a position index which holds every code point
+/// that has already been handled.
 template <typename OutputIterator>
-OutputIterator encode (std::u32string_view const& input,
-                       OutputIterator output) {
-  std::u32string nonbasic;
-  std::string::size_type num_basics = 0;
+OutputIterator encode_indexed (std::u32string_view const& input,
+                               code_point_position* const nonbasic,
+                               std::uint32_t* const tree,
+                               OutputIterator output) {
+  assert (input.size () < std::numeric_limits<std::uint32_t>::max ());
+  position_index index{tree, input.size ()};
   // Handle the basic code points. Copy them to the output in order followed by
   // a delimiter if any were copied.
-  for (auto cp : input) {
-    if (details::is_basic_code_point (cp)) {
+  auto num_nonbasic = std::size_t{0};
+  std::string::size_type num_basics = 0;
+  for (auto pos = std::size_t{0}; pos < input.size (); ++pos) {
+    auto const cp = input[pos];
+    if (is_basic_code_point (cp)) {
       *(output++) = static_cast<char> (cp);
       ++num_basics;
+      index.insert (pos);
     } else {
-      nonbasic += cp;
+      nonbasic[num_nonbasic++] = {cp, static_cast<std::uint32_t> (pos)};
     }
   }
-  {
-    // Sort and remove duplicates.
-    auto first = nonbasic.begin ();
-    auto last = nonbasic.end ();
-    std::sort (first, last);
-    nonbasic.erase (std::unique (first, last), last);
-  }
+  std::sort (nonbasic, nonbasic + num_nonbasic,
+             [] (code_point_position const& a, code_point_position const& b) {
+               return std::tie (a.cp, a.pos) < std::tie (b.cp, b.pos);
+             });
   auto i = num_basics;
   if (num_basics > 0) {
-    *(output++) = details::delimiter;
+    *(output++) = delimiter;
   }
-  auto n = details::initial_n;
+  auto n = initial_n;
   auto delta = std::string::size_type{0};
-  auto bias = details::initial_bias;
-  for (char32_t const m : nonbasic) {
+  auto bias = initial_bias;
+  auto const count_between = [&index] (std::size_t first, std::size_t last) {
+    return index.count_before (last) - index.count_before (first);
+  };
+  for (auto first = std::size_t{0}; first < num_nonbasic;) {
+    char32_t const m = nonbasic[first].cp;
     assert (m >= n);
     delta += (m - n) * (i + 1);
     n = m;
-    for (char32_t const c :
-         input) {  // for each code point c in the input (in order)
-      if (c < n) {
-        ++delta;  // increment delta (fail on overflow)
-      } else if (c == n) {
-        // Represent delta as a generalized variable-length integer.
-        output = details::encode_vli (delta, bias, output);
-        bias = details::adapt (delta, i + 1, i == num_basics);
-        delta = 0U;
-        ++i;
-      }
+    // Visit each instance of m in order. The index holds exactly the
+    // positions of the code points less than n.
+    auto last = first;
+    auto prev = std::size_t{0};
+    for (; last < num_nonbasic && nonbasic[last].cp == m; ++last) {
+      auto const pos = std::size_t{nonbasic[last].pos};
+      delta += count_between (prev, pos);
+      // Represent delta as a generalized variable-length integer.
+      output = encode_vli (delta, bias, output);
+      bias = adapt (delta, i + 1, i == num_basics);
+      delta = 0U;
+      ++i;
+      prev = pos + 1U;
+    }
+    delta += count_between (prev, input.size ());
+    for (; first < last; ++first) {
+      index.insert (nonbasic[first].pos);
     }
     ++delta;
     ++n;
@@ -154,9 +223,132 @@ OutputIterator encode (std::u32string_view const& input,
   return output;
 }
 
+}  // end namespace details
+
+/// The maximum number of code points in a label for which encode() uses no
+/// dynamically allocated storage. This is the maximum length of a DNS label.
+inline constexpr auto max_inline_label = std::size_t{63};
+
+template <typename OutputIterator>
+OutputIterator encode (std::u32string_view const& input,
+                       OutputIterator output) {
+  if (input.size () <= max_inline_label) {
+    std::array<details::code_point_position, max_inline_label> nonbasic;
+    std::array<std::uint32_t, max_inline_label> tree{};
+    return details::encode_indexed (input, nonbasic.data (), tree.data (),
+                                    output);
+  }
+  std::vector<details::code_point_position> nonbasic (input.size ());
+  std::vector<std::uint32_t> tree (input.size ());
+  return details::encode_indexed (input, nonbasic.data (), tree.data (),
+                                  output);
+}
+
 using decode_result = std::variant<std::error_code, std::u32string>;
 decode_result decode (std::string_view const& input);
 
+/// Decodes \p input writing the code points to the buffer [first, last). No
+/// dynamically allocated storage is used if \p input is no longer than
+/// max_inline_label. The output never has more code points than \p input has
+/// characters.
+///
+/// \returns The end of the decoded output or an error. The error is
+///   decode_error_code::too_long if the output would not fit in the buffer.
+std::variant<std::error_code, char32_t*> decode (std::string_view const& input,
+                                                char32_t* first,
+                                                char32_t* last);
+
+/// Decodes \p input writing the code points to the output iterator \p out.
+template <typename OutputIterator>
+std::variant<std::error_code, OutputIterator> decode (
+  std::string_view const& input, OutputIterator out) {
+  auto const copy = [&input, &out] (char32_t* const first,
+                                   char32_t* const last)
+    -> std::variant<std::error_code, OutputIterator> {
+    auto const r = decode (input, first, last);
+    if (auto const* const err = std::get_if<std::error_code> (&r)) {
+      return *err;
+    }
+    return std::copy (first, std::get<char32_t*> (r), out);
+  };
+  if (input.size () <= max_inline_label) {
+    std::array<char32_t, max_inline_label> buffer;
+    return copy (buffer.data (), buffer.data () + buffer.size ());
+  }
+  std::vector<char32_t> buffer (input.size ());
+  return copy (buffer.data (), buffer.data () + buffer.size ());
+}
+
+/// Decodes \p input writing the result as UTF-8 to the buffer [first, last).
+/// Each decoded code point needs no more than four bytes so a buffer of four
+/// times the size of \p input is always large enough.
+///
+/// \returns The end of the UTF-8 output or an error. The error is
+///   decode_error_code::bad_input if a decoded code point is not a Unicode
+///   scalar value (and so cannot be represented in UTF-8) or
+///   decode_error_code::too_long if the buffer has fewer than four bytes for
+///   each decoded code point.
+std::variant<std::error_code, char*> decode_utf8 (std::string_view const& input,
+                                                 char* first, char* last);
+
+/// Decodes \p input writing the result as UTF-8 to the output iterator
+/// \p out. Produces decode_error_code::bad_input if a decoded code point is
+/// not a Unicode scalar value (and so cannot be represented in UTF-8).
+template <typename OutputIterator>
+std::variant<std::error_code, OutputIterator> decode_utf8 (
+  std::string_view const& input, OutputIterator out) {
+  auto const copy = [&input, &out] (char* const first, char* const last)
+    -> std::variant<std::error_code, OutputIterator> {
+    auto const r = decode_utf8 (input, first, last);
+    if (auto const* const err = std::get_if<std::error_code> (&r)) {
+      return *err;
+    }
+    return std::copy (first, std::get<char*> (r), out);
+  };
+  if (input.size () <= max_inline_label) {
+    std::array<char, 4 * max_inline_label> buffer;
+    return copy (buffer.data (), buffer.data () + buffer.size ());
+  }
+  std::vector<char> buffer (4 * input.size ());
+  return copy (buffer.data (), buffer.data () + buffer.size ());
+}
+
+/// Encodes the UTF-8 string \p input appending the result to \p output.
+///
+/// \returns decode_error_code::bad_input if \p input is not well-formed UTF-8.
+std::error_code encode (std::string_view const& input, std::string& output);
+
+/// Decodes \p input appending the result as UTF-8 to \p output. This is
+/// decode_utf8() writing directly to the end of \p output; \p output is
+/// unchanged if an error is returned.
+std::error_code decode (std::string_view const& input, std::string& output);
+
+/// The result of a host conversion: either an error or the converted host.
+/// The converted host is either a view of the input (if no conversion was
+/// needed) or of the caller's buffer.
+using host_result = std::variant<std::error_code, std::string_view>;
+
+/// Converts a UTF-8 host name to its ASCII form. The host is split into
+/// labels at each '.'. Labels which are ASCII are unchanged (although any with
+/// the "xn--" prefix must be valid punycode); others are punycode encoded and
+/// given the "xn--" prefix. No Unicode mapping or normalization is performed.
+///
+/// If the host is ASCII, it is returned unchanged without touching
+/// \p buffer. Otherwise the result is built in \p buffer.
+///
+/// \returns The ASCII host or decode_error_code::bad_input if a label is not
+///   well-formed UTF-8 or is an invalid punycode label.
+host_result to_ascii (std::string_view host, std::string& buffer);
+
+/// Converts a host name in ASCII form to UTF-8. Each label with the "xn--"
+/// prefix is decoded; other labels are unchanged.
+///
+/// If the host has no "xn--" labels, it is returned unchanged without touching
+/// \p buffer. Otherwise the result is built in \p buffer.
+///
+/// \returns The UTF-8 host or an error if a label could not be decoded.
+host_result to_unicode (std::string_view host, std::string& buffer);
+
 }  // end namespace uri::punycode
 
 #endif  // URI_PUNYCODE_HPP
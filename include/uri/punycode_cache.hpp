@@ -0,0 +1,98 @@
+//===- include/uri/punycode_cache.hpp ---------------------*- mode: C++ -*-===//
+//*                                        _                        _          *
+//*  _ __  _   _ _ __  _   _  ___ ___   __| | ___     ___ __ _  ___| |__   ___ *
+//* | '_ \| | | | '_ \| | | |/ __/ _ \ / _` |/ _ \   / __/ _` |/ __| '_ \ / _ \*
+//* | |_) | |_| | | | | |_| | (_| (_) | (_| |  __/  | (_| (_| | (__| | | |  __/*
+//* | .__/ \__,_|_| |_|\__, |\___\___/ \__,_|\___|___\___\__,_|\___|_| |_|\___|*
+//* |_|                |___/                    |_____|                        *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#ifndef URI_PUNYCODE_CACHE_HPP
+#define URI_PUNYCODE_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace uri::punycode {
+
+struct cache_statistics {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  std::uint64_t evictions = 0;
+  std::size_t entries = 0;  ///< The number of entries currently cached.
+};
+
+/// A thread-safe cache of the results of the UTF-8 forms of encode() and
+/// decode(). It is intended to sit in front of those functions where the same
+/// labels are converted again and again.
+///
+/// The cache is divided into shards, each with its own lock and least recently
+/// used list, so that threads converting different labels rarely contend. All
+/// of the memory used by a shard is allocated when the cache is constructed:
+/// the keys and values are held in a single arena divided into fixed size
+/// slots and lookups and insertions never allocate. An entry whose key and
+/// value do not fit in a slot is not cached. Errors are not cached.
+class cache {
+public:
+  /// The maximum length of a DNS label.
+  static constexpr auto max_label = std::size_t{63};
+  /// The number of bytes in an arena slot. This is the maximum total size of
+  /// the key and value of a cached entry. The ACE form of a label has at most
+  /// max_label characters and each code point needs at least one of them so
+  /// its UTF-8 form has at most max_label four-byte code points. A slot
+  /// therefore holds any label and its conversion.
+  static constexpr auto slot_size = max_label + 4U * max_label;
+  static constexpr auto default_budget = std::size_t{1} << 20U;
+  static constexpr auto default_shards = 16U;
+  /// The largest number of shards.
+  static constexpr auto max_shards = 256U;
+
+  /// \param budget  The approximate number of bytes that the cache may use.
+  ///   The cache always holds at least one entry so a budget smaller than
+  ///   that (including zero) allocates storage for a single entry.
+  /// \param shards  The number of shards. This is rounded up to a power of
+  ///   two but is limited to max_shards and to the number of entries that
+  ///   the budget allows: each shard holds at least one entry.
+  explicit cache (std::size_t budget = default_budget,
+                  unsigned shards = default_shards);
+  cache (cache const&) = delete;
+  cache (cache&&) noexcept = delete;
+  ~cache () noexcept;
+
+  cache& operator= (cache const&) = delete;
+  cache& operator= (cache&&) noexcept = delete;
+
+  /// Equivalent to punycode::encode(input, output) but with the result taken
+  /// from the cache if present.
+  std::error_code encode (std::string_view const& input, std::string& output);
+  /// Equivalent to punycode::decode(input, output) but with the result taken
+  /// from the cache if present.
+  std::error_code decode (std::string_view const& input, std::string& output);
+
+  /// Returns the hit, miss, and eviction counts summed over all of the shards.
+  cache_statistics statistics () const;
+  /// Removes all entries and resets the counters.
+  void clear ();
+
+private:
+  class shard;
+  enum class operation : std::uint8_t { encode, decode };
+
+  template <typename Function>
+  std::error_code lookup (operation op, std::string_view const& input,
+                          std::string& output, Function compute);
+
+  std::unique_ptr<shard[]> shards_;
+  unsigned mask_ = 0;
+};
+
+}  // end namespace uri::punycode
+
+#endif  // URI_PUNYCODE_CACHE_HPP
@@ -0,0 +1,329 @@
+//===- include/uri/query.hpp ------------------------------*- mode: C++ -*-===//
+//*                               *
+//*   __ _ _   _  ___ _ __ _   _  *
+//*  / _` | | | |/ _ \ '__| | | | *
+//* | (_| | |_| |  __/ |  | |_| | *
+//*  \__, |\__,_|\___|_|   \__, | *
+//*     |_|                |___/  *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#ifndef URI_QUERY_HPP
+#define URI_QUERY_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if __has_include(<version>)
+#include <version>
+#endif
+
+#if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
+#include <ranges>
+#endif
+
+namespace uri {
+
+/// Returns true if \p s contains characters which must be decoded when it is
+/// interpreted as application/x-www-form-urlencoded text ('+' or '%').
+constexpr bool needs_form_decode (std::string_view const s) noexcept {
+  return s.find_first_of ("%+") != std::string_view::npos;
+}
+
+/// Decodes application/x-www-form-urlencoded text: each '+' becomes a space
+/// and percent-escapes are decoded. If \p s contains nothing which needs to be
+/// decoded it is returned as is and \p buffer is untouched; otherwise the
+/// decoded text is written to \p buffer and a view of it is returned.
+std::string_view form_decode (std::string_view s, std::string& buffer);
+
+/// A single name/value pair from a query string. The key and value are views
+/// of the original (undecoded) query text.
+struct query_param {
+  std::string_view key;
+  std::string_view value;
+
+  /// Returns the decoded key. \see form_decode()
+  std::string_view decoded_key (std::string& buffer) const {
+    return form_decode (key, buffer);
+  }
+  /// Returns the decoded value. \see form_decode()
+  std::string_view decoded_value (std::string& buffer) const {
+    return form_decode (value, buffer);
+  }
+
+  bool operator== (query_param const& rhs) const noexcept {
+    return key == rhs.key && value == rhs.value;
+  }
+  bool operator!= (query_param const& rhs) const noexcept {
+    return !operator== (rhs);
+  }
+};
+
+/// A forward iterator over the name/value pairs of an
+/// application/x-www-form-urlencoded query string such as
+/// "key1=value1&key2=value2". Pairs are separated by '&' and empty pairs are
+/// skipped. A key is separated from its value by the first '=': if there is
+/// no '=', the value is empty.
+///
+/// The iterator never allocates and never decodes: the pairs that it yields
+/// are views of the query text.
+class query_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = query_param;
+  using difference_type = std::ptrdiff_t;
+  using pointer = value_type const*;
+  using reference = value_type const&;
+
+  constexpr query_iterator () noexcept = default;
+  /// \param rest  The query text starting at the first pair.
+  constexpr explicit query_iterator (std::string_view rest) noexcept
+      : rest_{rest} {
+    this->next_param ();
+  }
+
+  constexpr bool operator== (query_iterator const& other) const noexcept {
+    return rest_.data () == other.rest_.data ();
+  }
+#if __cplusplus < 202002L
+  constexpr bool operator!= (query_iterator const& other) const noexcept {
+    return !operator== (other);
+  }
+#endif
+
+  constexpr reference operator* () const noexcept { return param_; }
+  constexpr pointer operator->() const noexcept { return &param_; }
+
+  constexpr query_iterator& operator++ () noexcept {
+    rest_.remove_prefix (consumed_);
+    this->next_param ();
+    return *this;
+  }
+  constexpr query_iterator operator++ (int) noexcept {
+    auto const prev = *this;
+    ++(*this);
+    return prev;
+  }
+
+private:
+  static constexpr auto separator = '&';
+  static constexpr auto equals = '=';
+
+  constexpr void next_param () noexcept {
+    // Skip empty pairs.
+    auto const start = rest_.find_first_not_of (separator);
+    rest_.remove_prefix (start == std::string_view::npos ? rest_.length ()
+                                                         : start);
+    if (rest_.empty ()) {
+      param_ = query_param{};
+      consumed_ = 0;
+      return;
+    }
+    auto const pair = rest_.substr (0, rest_.find (separator));
+    consumed_ = pair.length ();
+    if (auto const eq = pair.find (equals); eq != std::string_view::npos) {
+      param_ = query_param{pair.substr (0, eq), pair.substr (eq + 1)};
+    } else {
+      param_ = query_param{pair, std::string_view{}};
+    }
+  }
+
+  std::string_view rest_;  ///< The query text starting at the current pair.
+  query_param param_;      ///< The current pair.
+  std::size_t consumed_ = 0;  ///< The number of characters in the pair.
+};
+
+/// A range of the name/value pairs of a query string. For example:
+///
+///     std::string buffer;
+///     for (auto const& param : uri::query_params{p.query}) {
+///       if (param.key == "id") {
+///         use (param.decoded_value (buffer));
+///       }
+///     }
+///
+/// \see query_iterator
+class query_params {
+public:
+  constexpr query_params () noexcept = default;
+  constexpr explicit query_params (std::string_view const query) noexcept
+      : query_{query} {}
+  /// Constructs the range from an optional query such as parts::query. If the
+  /// query is absent, the range is empty.
+  template <typename Optional,
+            typename = std::enable_if_t<std::is_same_v<
+              Optional, std::optional<std::string_view>>>>
+  constexpr explicit query_params (Optional const& query) noexcept
+      : query_{query.value_or (std::string_view{})} {}
+
+  constexpr query_iterator begin () const noexcept {
+    return query_iterator{query_};
+  }
+  constexpr query_iterator end () const noexcept {
+    return query_iterator{query_.substr (query_.length ())};
+  }
+
+private:
+  std::string_view query_;
+};
+
+/// An index of the name/value pairs of a query string which is built once and
+/// then gives constant time lookup by key. It is the query equivalent of the
+/// parts breakdown which split() produces for a whole URI.
+///
+/// Keys are compared after form-decoding so that find("first name") matches
+/// "first+name=..."; values are the raw views of the query text. A key may
+/// have any number of values. Queries with no more than inline_params pairs
+/// are indexed without touching the heap (unless a key must be decoded).
+///
+/// The index refers to the query text which must outlive it.
+class query_index {
+  struct entry {
+    query_param param;     ///< The raw key/value pair.
+    std::string_view key;  ///< The form-decoded key.
+    std::uint32_t next;    ///< The next entry with the same key.
+    std::uint32_t tail;    ///< The last entry with the same key.
+  };
+  static constexpr auto no_entry = ~std::uint32_t{0};
+
+public:
+  static constexpr auto inline_params = std::size_t{16};
+
+  class value_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type const*;
+    using reference = value_type const&;
+
+    constexpr value_iterator () noexcept = default;
+    constexpr value_iterator (entry const* const entries,
+                              std::uint32_t const index) noexcept
+        : entries_{entries}, index_{index} {}
+
+    constexpr bool operator== (value_iterator const& other) const noexcept {
+      return index_ == other.index_;
+    }
+#if __cplusplus < 202002L
+    constexpr bool operator!= (value_iterator const& other) const noexcept {
+      return !operator== (other);
+    }
+#endif
+
+    constexpr reference operator* () const noexcept {
+      return entries_[index_].param.value;
+    }
+    constexpr pointer operator->() const noexcept { return &**this; }
+
+    constexpr value_iterator& operator++ () noexcept {
+      index_ = entries_[index_].next;
+      return *this;
+    }
+    constexpr value_iterator operator++ (int) noexcept {
+      auto const prev = *this;
+      ++(*this);
+      return prev;
+    }
+
+  private:
+    entry const* entries_ = nullptr;
+    std::uint32_t index_ = no_entry;
+  };
+
+  /// The values associated with a single key, in the order that they appear
+  /// in the query.
+  class value_range {
+  public:
+    constexpr value_range () noexcept = default;
+    constexpr value_range (value_iterator const first,
+                           value_iterator const last) noexcept
+        : first_{first}, last_{last} {}
+    constexpr value_iterator begin () const noexcept { return first_; }
+    constexpr value_iterator end () const noexcept { return last_; }
+    constexpr bool empty () const noexcept { return first_ == last_; }
+
+  private:
+    value_iterator first_;
+    value_iterator last_;
+  };
+
+  explicit query_index (std::string_view query);
+  /// Constructs the index from an optional query such as parts::query. If the
+  /// query is absent, the index is empty.
+  template <typename Optional,
+            typename = std::enable_if_t<std::is_same_v<
+              Optional, std::optional<std::string_view>>>>
+  explicit query_index (Optional const& query)
+      : query_index (query.value_or (std::string_view{})) {}
+
+  // Decoded keys refer to storage owned by the index so copying is
+  // disallowed. Moving preserves that storage and leaves the source empty.
+  query_index (query_index const&) = delete;
+  query_index (query_index&& other) noexcept;
+  query_index& operator= (query_index const&) = delete;
+  query_index& operator= (query_index&& other) noexcept;
+  ~query_index () noexcept = default;
+
+  /// Returns the number of name/value pairs in the query.
+  constexpr std::size_t size () const noexcept { return size_; }
+  constexpr bool empty () const noexcept { return size_ == 0; }
+
+  /// Returns the first value associated with \p key or std::nullopt if the
+  /// key is not present.
+  std::optional<std::string_view> find (std::string_view key) const noexcept;
+  /// Returns all of the values associated with \p key.
+  value_range values (std::string_view key) const noexcept;
+  /// Returns the number of values associated with \p key.
+  std::size_t count (std::string_view key) const noexcept;
+  bool contains (std::string_view key) const noexcept {
+    return this->head (key) != no_entry;
+  }
+
+  /// Returns the pair at position \p pos in the query.
+  query_param const& operator[] (std::size_t const pos) const noexcept {
+    return this->entries ()[pos].param;
+  }
+
+private:
+  entry const* entries () const noexcept {
+    return heap_entries_.empty () ? inline_entries_.data ()
+                                  : heap_entries_.data ();
+  }
+  std::uint32_t const* slots () const noexcept {
+    return heap_slots_.empty () ? inline_slots_.data () : heap_slots_.data ();
+  }
+  /// Returns the index of the first entry with key \p key or no_entry.
+  std::uint32_t head (std::string_view key) const noexcept;
+  /// Makes this an empty index using the inline storage.
+  void reset () noexcept;
+
+  std::size_t size_ = 0;
+  std::size_t mask_ = 0;  ///< The number of slots less one.
+  std::array<entry, inline_params> inline_entries_{};
+  std::array<std::uint32_t, inline_params * 2> inline_slots_{};
+  std::vector<entry> heap_entries_;
+  std::vector<std::uint32_t> heap_slots_;
+  /// Storage for keys which must be form-decoded.
+  std::vector<char> decoded_keys_;
+};
+
+}  // end namespace uri
+
+#if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
+// The pairs refer to the underlying text rather than the range object.
+template <>
+inline constexpr bool std::ranges::enable_borrowed_range<uri::query_params> =
+  true;
+#endif  // __cpp_lib_ranges
+
+#endif  // URI_QUERY_HPP
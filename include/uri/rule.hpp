@@ -75,6 +75,38 @@
 /// function evaluates each of the alternative rules from left to right and
 /// stops as soon as one is matched. Care needs to be taken where there is
 /// potential ambiguity between alternative rules.
+///
+/// # Memoization
+///
+/// Alternatives which begin with the same production match it again at the
+/// same position for each branch. Wrapping such a production in
+/// `memoized<>` and constructing the rule with a memo table records each
+/// result so that it is usually only matched once:
+///
+/// ~~~cpp
+/// fixed_memo_table<64> memo;
+/// rule{str, memo}.alternative (
+///   [] (rule const& r1) { return r1.concat (memoized<A>).concat (B)...; },
+///   [] (rule const& r2) { return r2.concat (memoized<A>).concat (C)...; });
+/// ~~~
+///
+/// The table is bounded so, unlike a full packrat parser, this does not
+/// guarantee that a parse takes linear time. None of the library's own
+/// parsers use a memo table.
+///
+/// # Tracing
+///
+/// If the library is built with the URI_TRACE CMake option, matched() counts
+/// the attempts, successes, failures, and bytes consumed for each named
+/// production. See uri/trace.hpp.
+///
+/// # Diagnostics
+///
+/// If a rule is constructed with a furthest_failure record, failing matches
+/// record the furthest position in the input that the parse reached and the
+/// name of the innermost production which failed there. This is useful when
+/// reporting why an input was rejected. The record is carried by the rule so
+/// a parse started without one only tests a null pointer when a match fails.
 
 #ifndef URI_RULE_HPP
 #define URI_RULE_HPP
@@ -83,16 +115,67 @@
 #include <array>
 #include <cassert>
 #include <cctype>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <limits>
 #include <optional>
 #include <string_view>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace uri {
 
+class memo_table;
+namespace grammar {
+class reporter;
+}  // end namespace grammar
+
+// furthest failure
+// ~~~~~~~~~~~~~~~~
+/// Records the furthest position at which a match failed and the name of the
+/// innermost production (as passed to rule::matched()) which failed there.
+/// A record is passed to the rule which starts a parse.
+class furthest_failure {
+public:
+  /// The furthest position at which a match failed or nullptr if there were
+  /// no failures.
+  [[nodiscard]] constexpr char const* position () const noexcept {
+    return position_;
+  }
+  /// The name of the innermost production which failed at position() or
+  /// nullptr if it is not known.
+  [[nodiscard]] constexpr char const* production () const noexcept {
+    return production_;
+  }
+
+private:
+  friend class rule;
+  friend class grammar::reporter;
+
+  /// Notes that a match failed at \p pos.
+  constexpr void fail (char const* const pos) noexcept {
+    if (position_ == nullptr || pos > position_) {
+      position_ = pos;
+      production_ = nullptr;
+    }
+  }
+  /// Notes that the production \p name which started at \p start has failed.
+  /// This names the furthest failure if it has not yet been named and lies
+  /// within the production.
+  constexpr void fail (char const* const name,
+                       char const* const start) noexcept {
+    if (production_ == nullptr && position_ != nullptr && start <= position_) {
+      production_ = name;
+    }
+  }
+
+  char const* position_ = nullptr;
+  char const* production_ = nullptr;
+};
+
 class rule {
 public:
   using acceptor_container = std::vector<
@@ -101,6 +184,16 @@ public:
     std::optional<std::tuple<std::string_view, acceptor_container>>;
 
   explicit rule (std::string_view string) : tail_{string} {}
+  /// Starts a parse of \p string which memoizes the results of productions
+  /// in \p memo. Any results already in \p memo are discarded.
+  rule (std::string_view string, memo_table& memo);
+  /// Starts a parse of \p string which records its furthest failure in
+  /// \p failure.
+  rule (std::string_view string, furthest_failure& failure)
+      : tail_{string}, failure_{&failure} {}
+  /// Starts a parse of \p string which memoizes the results of productions
+  /// in \p memo and records its furthest failure in \p failure.
+  rule (std::string_view string, memo_table& memo, furthest_failure& failure);
   rule (rule const& rhs) = default;
   rule (rule&& rhs) noexcept = default;
   ~rule () noexcept = default;
@@ -110,6 +203,17 @@ public:
 
   [[nodiscard]] bool done () const;
 
+  /// Returns a rule which sees no more than the first \p length characters of
+  /// this rule's input. The result does not use the memo table since the
+  /// results of matches within the shortened input may differ from those
+  /// within the whole input.
+  [[nodiscard]] rule prefix (std::size_t const length) const {
+    if (!tail_) {
+      return *this;
+    }
+    return {tail_->substr (0, length), acceptors_, nullptr, failure_};
+  }
+
   template <typename MatchFunction, typename AcceptFunction,
             typename = std::enable_if_t<
               std::is_invocable_v<MatchFunction, rule&&> &&
@@ -167,6 +271,14 @@ public:
 
   [[nodiscard]] matched_result matched (char const* name, rule const& in) const;
 
+  /// Matches \p Match. If the rule was constructed with a memo table, the
+  /// result of matching \p Match at this position is recorded there and later
+  /// attempts at the same position reuse it. This is intended to be called
+  /// from a match function (see uri::memoized<>) since the result includes
+  /// any acceptors already held by this rule.
+  template <auto Match>
+  [[nodiscard]] matched_result memoize () const;
+
   template <typename Predicate>
   [[nodiscard]] matched_result single_char (Predicate pred) const;
   [[nodiscard]] matched_result single_char (char const c) const {
@@ -176,14 +288,34 @@ public:
   }
 
 private:
-  rule (std::optional<std::string_view> tail, acceptor_container acceptors)
-      : tail_{tail}, acceptors_{std::move (acceptors)} {}
+  friend class grammar::reporter;
+
+  rule (std::optional<std::string_view> tail, acceptor_container acceptors,
+        memo_table* memo, furthest_failure* failure)
+      : tail_{tail},
+        acceptors_{std::move (acceptors)},
+        memo_{memo},
+        failure_{failure} {}
   rule () noexcept = default;
 
+  /// Returns a rule which matches \p str using the same memo table and
+  /// failure record as this one.
+  [[nodiscard]] rule sub (std::string_view const str) const {
+    return {str, acceptor_container{}, memo_, failure_};
+  }
+
   template <typename MatchFunction, typename AcceptFunction>
   rule concat_impl (MatchFunction match, AcceptFunction accept,
                     bool optional) const;
 
+  /// Sends a failure to match at \p pos to the furthest_failure record, if
+  /// any.
+  void failed_at (char const* const pos) const noexcept {
+    if (failure_ != nullptr) {
+      failure_->fail (pos);
+    }
+  }
+
   static acceptor_container join (acceptor_container const& a,
                                   acceptor_container const& b) {
     acceptor_container result;
@@ -195,11 +327,13 @@ private:
 
   [[nodiscard]] rule join_rule (matched_result::value_type const& m) const {
     auto const& [head, acc] = m;
-    return {tail_->substr (head.length ()), join (acceptors_, acc)};
+    return {tail_->substr (head.length ()), join (acceptors_, acc), memo_,
+            failure_};
   }
 
   [[nodiscard]] rule join_rule (rule const& other) const {
-    return {other.tail_, join (acceptors_, other.acceptors_)};
+    return {other.tail_, join (acceptors_, other.acceptors_), memo_,
+            failure_};
   }
 
   static void accept_nop (std::string_view str) {
@@ -211,8 +345,183 @@ private:
 
   std::optional<std::string_view> tail_;
   acceptor_container acceptors_;
+  memo_table* memo_ = nullptr;
+  furthest_failure* failure_ = nullptr;
 };
 
+// memo table
+// ~~~~~~~~~~
+/// A bounded table of the results of matching productions at positions in the
+/// input ("packrat" memoization). A grammar in which alternatives repeatedly
+/// try the same production at the same position can then match each one only
+/// once.
+///
+/// The table is direct-mapped: each (production, position) pair has a single
+/// slot and a newer result replaces an older one. The acceptors belonging to
+/// results are held in an arena which is bounded in size; a result whose
+/// acceptors do not fit is not recorded. A result which has been replaced or
+/// was not recorded is matched again when it is next needed, so the table
+/// reduces repeated work but does not bound a parse to linear time. A table
+/// belongs to one parse at a time: constructing a rule with the table
+/// discards its previous contents.
+class memo_table {
+public:
+  struct entry {
+    void const* production = nullptr;
+    char const* position = nullptr;
+    std::uint32_t generation = 0;
+    std::uint32_t length = 0;
+    std::uint32_t first_acceptor = 0;
+    std::uint16_t num_acceptors = 0;
+    bool matched = false;
+  };
+
+  /// \param entries  Storage for the table.
+  /// \param capacity  The number of entries. Must be a power of two.
+  /// \param max_acceptors  The maximum number of acceptors held.
+  memo_table (entry* const entries, std::size_t const capacity,
+              std::size_t const max_acceptors) noexcept
+      : entries_{entries},
+        mask_{capacity - 1U},
+        max_acceptors_{max_acceptors} {
+    assert (capacity > 0U && (capacity & mask_) == 0U);
+    assert (max_acceptors <= std::numeric_limits<std::uint32_t>::max ());
+  }
+  memo_table (memo_table const&) = delete;
+  memo_table (memo_table&&) noexcept = delete;
+  ~memo_table () noexcept = default;
+
+  memo_table& operator= (memo_table const&) = delete;
+  memo_table& operator= (memo_table&&) noexcept = delete;
+
+  /// Discards all of the recorded results.
+  void clear () noexcept;
+
+  /// The number of lookups which found a recorded result.
+  constexpr std::size_t hits () const noexcept { return hits_; }
+  /// The number of lookups which did not find a recorded result.
+  constexpr std::size_t misses () const noexcept { return misses_; }
+
+private:
+  friend class rule;
+
+  /// Returns the slot for \p production at \p position.
+  entry& slot (void const* const production,
+               char const* const position) noexcept {
+    auto const p = reinterpret_cast<std::uintptr_t> (position);
+    auto const h = reinterpret_cast<std::uintptr_t> (production);
+    return entries_[(p ^ (h >> 4U) ^ (p >> 7U)) & mask_];
+  }
+  bool is_current (entry const& e, void const* const production,
+                   char const* const position) const noexcept {
+    return e.generation == generation_ && e.production == production &&
+           e.position == position;
+  }
+
+  entry* entries_;
+  std::size_t mask_;
+  std::size_t max_acceptors_;
+  std::uint32_t generation_ = 0;
+  std::size_t hits_ = 0;
+  std::size_t misses_ = 0;
+  rule::acceptor_container acceptors_;
+};
+
+/// A memo table with storage for \p Capacity entries and up to
+/// \p MaxAcceptors acceptors.
+template <std::size_t Capacity, std::size_t MaxAcceptors = Capacity>
+class fixed_memo_table : public memo_table {
+public:
+  fixed_memo_table () noexcept
+      : memo_table{storage_.data (), Capacity, MaxAcceptors} {}
+
+private:
+  std::array<entry, Capacity> storage_{};
+};
+
+inline void memo_table::clear () noexcept {
+  if (++generation_ == 0U) {
+    // The generation has wrapped: make sure no old entry looks current.
+    std::fill_n (entries_, mask_ + 1U, entry{});
+    generation_ = 1U;
+  }
+  acceptors_.clear ();
+  hits_ = 0;
+  misses_ = 0;
+}
+
+inline rule::rule (std::string_view const string, memo_table& memo)
+    : tail_{string}, memo_{&memo} {
+  memo.clear ();
+}
+inline rule::rule (std::string_view const string, memo_table& memo,
+                   furthest_failure& failure)
+    : tail_{string}, memo_{&memo}, failure_{&failure} {
+  memo.clear ();
+}
+
+// memoize
+// ~~~~~~~
+template <auto Match>
+auto rule::memoize () const -> matched_result {
+  // The address of this object identifies the production.
+  static char production;
+  if (memo_ == nullptr || !tail_) {
+    return Match (*this);
+  }
+  auto const* const position = tail_->data ();
+  memo_table::entry& e = memo_->slot (&production, position);
+  if (memo_->is_current (e, &production, position)) {
+    ++memo_->hits_;
+    if (!e.matched) {
+      return {};
+    }
+    auto const first = std::begin (memo_->acceptors_) +
+                       static_cast<std::ptrdiff_t> (e.first_acceptor);
+    return std::make_tuple (
+      tail_->substr (0, e.length),
+      acceptor_container{
+        first, first + static_cast<std::ptrdiff_t> (e.num_acceptors)});
+  }
+  ++memo_->misses_;
+  matched_result result = Match (*this);
+  auto const* const acc =
+    result ? &std::get<acceptor_container> (*result) : nullptr;
+  if (acc != nullptr &&
+      (memo_->acceptors_.size () + acc->size () > memo_->max_acceptors_ ||
+       acc->size () > std::numeric_limits<std::uint16_t>::max () ||
+       std::get<std::string_view> (*result).length () >
+         std::numeric_limits<std::uint32_t>::max ())) {
+    return result;  // The result cannot be recorded.
+  }
+  e.production = &production;
+  e.position = position;
+  e.generation = memo_->generation_;
+  e.matched = result.has_value ();
+  e.length = 0;
+  e.first_acceptor = static_cast<std::uint32_t> (memo_->acceptors_.size ());
+  e.num_acceptors = 0;
+  if (acc != nullptr) {
+    e.length = static_cast<std::uint32_t> (
+      std::get<std::string_view> (*result).length ());
+    e.num_acceptors = static_cast<std::uint16_t> (acc->size ());
+    memo_->acceptors_.insert (std::end (memo_->acceptors_), std::begin (*acc),
+                              std::end (*acc));
+  }
+  return result;
+}
+
+/// A match function which memoizes the results of the match function \p Match.
+/// For example:
+///
+/// ~~~cpp
+/// r.alternative (...).concat (memoized<h16>)
+/// ~~~
+template <auto Match>
+rule::matched_result memoized (rule const& r) {
+  return r.memoize<Match> ();
+}
+
 // star
 // ~~~~
 template <typename MatchFunction, typename>
@@ -226,8 +535,9 @@ rule rule::star (MatchFunction const match, unsigned const min,
   auto acc = acceptors_;
   auto count = 0U;
   for (;;) {
-    matched_result const m = match (rule{str});
+    matched_result const m = match (sub (str));
     if (!m) {
+      failed_at (str.data ());
       break;  // No match so no more repetitions.
     }
     ++count;
@@ -245,7 +555,7 @@ rule rule::star (MatchFunction const match, unsigned const min,
     return {};
   }
 
-  return {tail_->substr (length), std::move (acc)};
+  return {tail_->substr (length), std::move (acc), memo_, failure_};
 }
 
 // alternative
@@ -256,9 +566,10 @@ rule rule::alternative (MatchFunction match, Rest&&... rest) const {
     // If matching has already failed, then pass that condition down the chain.
     return *this;
   }
-  if (matched_result const m = match (rule{*tail_})) {
+  if (matched_result const m = match (sub (*tail_))) {
     return join_rule (*m);
   }
+  failed_at (tail_->data ());
   // This didn't match, so try the next one.
   return this->alternative (std::forward<Rest> (rest)...);
 }
@@ -280,7 +591,7 @@ rule rule::optional (MatchFunction match, AcceptFunction accept) const {
   if (!tail_) {
     return *this;  // If matching previously failed, yield failure.
   }
-  rule res = rule{*tail_}.concat_impl (match, accept, true);
+  rule res = sub (*tail_).concat_impl (match, accept, true);
   if (!res.tail_) {
     return *this;  // The rule failed, so carry on as if nothing happened.
   }
@@ -301,13 +612,14 @@ rule rule::concat_impl (MatchFunction match, AcceptFunction accept,
     // If matching has already failed, then pass that condition down the chain.
     return *this;
   }
-  if (matched_result m = match (rule{*tail_})) {
+  if (matched_result m = match (sub (*tail_))) {
     if (!is_nop (accept)) {
       std::get<acceptor_container> (*m).emplace_back (
         accept, std::get<std::string_view> (*m));
     }
     return join_rule (*m);
   }
+  failed_at (tail_->data ());
   if (optional) {
     return *this;
   }
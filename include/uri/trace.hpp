@@ -0,0 +1,90 @@
+//===- include/uri/trace.hpp ------------------------------*- mode: C++ -*-===//
+//*  _                       *
+//* | |_ _ __ __ _  ___ ___  *
+//* | __| '__/ _` |/ __/ _ \ *
+//* | |_| | | (_| | (_|  __/ *
+//*  \__|_|  \__,_|\___\___| *
+//*                          *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file trace.hpp
+/// \brief Counters for each of the named productions of a rule grammar.
+///
+/// When the library is built with the URI_TRACE CMake option, rule::matched()
+/// records each attempt to match a named production: whether it succeeded and
+/// how many characters it consumed. A grammar::named<> production matched
+/// through grammar::as_rule is recorded in the same way. Counting is off
+/// until enabled at run time with trace::enable(). Without URI_TRACE, the
+/// hook is compiled out and the functions here report no data.
+#ifndef URI_TRACE_HPP
+#define URI_TRACE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef URI_TRACE
+#define URI_TRACE 0
+#endif
+
+namespace uri::trace {
+
+struct counters {
+  std::uint64_t attempts = 0;
+  std::uint64_t successes = 0;
+  std::uint64_t failures = 0;
+  std::uint64_t bytes = 0;  ///< The number of characters consumed.
+
+  bool operator== (counters const& rhs) const noexcept {
+    return attempts == rhs.attempts && successes == rhs.successes &&
+           failures == rhs.failures && bytes == rhs.bytes;
+  }
+  bool operator!= (counters const& rhs) const noexcept {
+    return !operator== (rhs);
+  }
+};
+
+/// True if the library was built with the hook in rule::matched().
+inline constexpr bool available = URI_TRACE != 0;
+
+namespace details {
+
+inline std::atomic<bool> active{false};
+
+/// Records an attempt to match the production \p name which must have static
+/// storage duration.
+void record (char const* name, bool success, std::size_t bytes);
+
+}  // end namespace details
+
+/// Starts or stops counting. Counting is initially stopped.
+inline void enable (bool const on = true) noexcept {
+  details::active.store (available && on, std::memory_order_relaxed);
+}
+/// Returns true if counting is in progress.
+inline bool enabled () noexcept {
+  return details::active.load (std::memory_order_relaxed);
+}
+
+/// Discards all of the counts recorded so far.
+void reset ();
+
+/// Returns the counters for each production that has been attempted, ordered
+/// from the most to the least frequently attempted.
+std::vector<std::pair<std::string, counters>> snapshot ();
+
+/// Writes the counters to \p os as a table.
+std::ostream& write_table (std::ostream& os);
+/// Writes the counters to \p os as a JSON array of objects.
+std::ostream& write_json (std::ostream& os);
+
+}  // end namespace uri::trace
+
+#endif  // URI_TRACE_HPP
@@ -13,10 +13,14 @@
 #ifndef URI_URI_HPP
 #define URI_URI_HPP
 
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <limits>
 #include <optional>
 #include <string>
 #include <string_view>
+#include <variant>
 #include <vector>
 
 #include "uri/pctdecode.hpp"
@@ -99,12 +103,101 @@ std::ostream& operator<< (std::ostream& os,
                           struct parts::authority const& auth);
 std::ostream& operator<< (std::ostream& os, parts const& p);
 
+/// Limits on the inputs accepted by split(). These are intended as a cheap
+/// defence against hostile input. The overall length is checked before parsing
+/// begins and the path stops collecting segments once max_segments is reached.
+/// The host and query productions see only a few characters more than their
+/// limits allow so the cost of rejecting an over-long host or query depends on
+/// the limit rather than on the length of the input. (The optional userinfo
+/// which precedes the host is not limited and may scan further.)
+struct split_options {
+  static constexpr auto unlimited = std::numeric_limits<std::size_t>::max ();
+
+  /// The maximum length of the input.
+  std::size_t max_length = unlimited;
+  /// The maximum number of path segments.
+  std::size_t max_segments = unlimited;
+  /// The maximum length of the host.
+  std::size_t max_host_length = unlimited;
+  /// The maximum length of the query (excluding the leading "?").
+  std::size_t max_query_length = unlimited;
+};
+
 std::optional<parts> split (std::string_view in);
+/// Splits \p in into its components, rejecting it if it exceeds any of the
+/// limits given by \p options.
+std::optional<parts> split (std::string_view in, split_options const& options);
+
+struct split_error {
+  /// The offset within the input of the furthest character that the parser
+  /// reached before failing.
+  std::size_t offset = 0;
+  /// The name of the innermost grammar production which failed at offset.
+  std::string_view production;
+
+  bool operator== (split_error const& rhs) const noexcept {
+    return offset == rhs.offset && production == rhs.production;
+  }
+  bool operator!= (split_error const& rhs) const noexcept {
+    return !operator== (rhs);
+  }
+};
+
+using split_result = std::variant<split_error, parts>;
+
+/// Equivalent to split() except that if \p in is not a valid URI-reference,
+/// the furthest offset that the parser reached and the name of the production
+/// which failed there are returned. Collecting this information costs almost
+/// nothing when the input is valid.
+///
+/// \param in  The string to be split.
+/// \param options  Limits on the input.
+/// \returns The components of \p in or a description of the failure.
+split_result split_with_diagnostics (std::string_view in,
+                                     split_options const& options = {});
+
+/// The forms of HTTP request-target defined by RFC 9112 section 3.2.
+enum class request_target_form : std::uint8_t {
+  origin,     ///< absolute-path [ "?" query ]
+  absolute,   ///< absolute-URI
+  authority,  ///< uri-host ":" port
+  asterisk,   ///< "*"
+};
+
+struct request_target {
+  request_target_form form = request_target_form::origin;
+  /// The components of the target. For the asterisk-form, the path has a
+  /// single segment "*".
+  struct parts parts;
+};
+
+/// Parses the request-target of an HTTP request line. Only the four forms
+/// permitted by RFC 9112 are accepted and the form is chosen by the first
+/// character of the input. The origin-form, by far the most common, is parsed
+/// by a single pass over the input.
+///
+/// A target such as "example.com:443" matches both the authority-form and
+/// the absolute-form; it is treated as the authority-form since an HTTP URI
+/// in the absolute-form always has an authority.
+///
+/// \param in  The request-target to be parsed.
+/// \param options  Limits on the input.
+/// \returns The form and components of \p in or std::nullopt if it is not a
+///   valid request-target.
+std::optional<request_target> parse_request_target (
+  std::string_view in, split_options const& options = {});
 
 parts join (parts const& base, parts const& reference, bool strict = true);
 std::optional<parts> join (std::string_view Base, std::string_view R,
                            bool strict = true);
 
+/// The inverse of join(): produces the shortest reference which, when joined
+/// with \p base, yields \p target. The target is expected to be free of
+/// dot-segments (as is any result of join()).
+parts make_relative (parts const& base, parts const& target);
+std::optional<parts> make_relative (std::string_view base,
+                                    std::string_view target);
+
 std::string compose (parts const& p);
 std::ostream& compose (std::ostream& os, parts const& p);
 
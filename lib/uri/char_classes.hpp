@@ -0,0 +1,95 @@
+//===- lib/uri/char_classes.hpp ---------------------------*- mode: C++ -*-===//
+//*       _                     _                         *
+//*   ___| |__   __ _ _ __  ___| | __ _ ___ ___  ___ ___  *
+//*  / __| '_ \ / _` | '__|/ __| |/ _` / __/ __|/ _ Y __| *
+//* | (__| | | | (_| | |  | (__| | (_| \__ \__ \  __|__ \ *
+//*  \___|_| |_|\__,_|_|___\___|_|\__,_|___/___/\___|___/ *
+//*                   |_____|                             *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file char_classes.hpp
+/// \brief A table of the RFC 3986 character classes used by the hand-written
+/// scanners.
+#ifndef URI_CHAR_CLASSES_HPP
+#define URI_CHAR_CLASSES_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "uri/grammar.hpp"
+
+namespace uri::details {
+
+// character classes
+// ~~~~~~~~~~~~~~~~~
+// Characters are classified with a single table lookup per byte.
+enum : std::uint8_t {
+  scheme_char = 1U << 0U,   // ALPHA / DIGIT / "+" / "-" / "."
+  reg_char = 1U << 1U,      // unreserved / sub-delims
+  nc_char = 1U << 2U,       // unreserved / sub-delims / "@"
+  pchar = 1U << 3U,         // unreserved / sub-delims / ":" / "@"
+  query_char = 1U << 4U,    // pchar / "/" / "?"
+  literal_char = 1U << 5U,  // unreserved / sub-delims / ":"
+  hex_char = 1U << 6U,      // HEXDIG
+  digit_char = 1U << 7U,    // DIGIT
+};
+
+constexpr std::array<std::uint8_t, 256> make_classes () noexcept {
+  namespace g = uri::grammar;
+  using sub_delims =
+    g::one<'!', '$', '&', '\'', '(', ')', '*', '+', ',', ';', '='>;
+  std::array<std::uint8_t, 256> result{};
+  for (auto ctr = std::size_t{0}; ctr < result.size (); ++ctr) {
+    auto const c = static_cast<char> (ctr);
+    auto const alnum = g::alpha::test (c) || g::digit::test (c);
+    auto& r = result[ctr];
+    if (alnum || g::one<'+', '-', '.'>::test (c)) {
+      r |= scheme_char;
+    }
+    if (alnum || g::one<'-', '.', '_', '~'>::test (c) || sub_delims::test (c)) {
+      r |= reg_char | nc_char | pchar | query_char | literal_char;
+    }
+    if (c == '@') {
+      r |= nc_char | pchar | query_char;
+    }
+    if (c == ':') {
+      r |= pchar | query_char | literal_char;
+    }
+    if (c == '/' || c == '?') {
+      r |= query_char;
+    }
+    if (g::hexdig::test (c)) {
+      r |= hex_char;
+    }
+    if (g::digit::test (c)) {
+      r |= digit_char;
+    }
+  }
+  return result;
+}
+
+inline constexpr auto classes = make_classes ();
+
+constexpr bool is (char const c, std::uint8_t const mask) noexcept {
+  return (classes[static_cast<std::uint8_t> (c)] & mask) != 0U;
+}
+
+/// Returns the position of the first character at or after \p pos which is
+/// not a member of the classes given by \p mask.
+inline std::size_t skip (std::string_view const s, std::size_t pos,
+                         std::uint8_t const mask) noexcept {
+  auto const size = s.size ();
+  while (pos < size && is (s[pos], mask)) {
+    ++pos;
+  }
+  return pos;
+}
+
+}  // end namespace uri::details
+
+#endif  // URI_CHAR_CLASSES_HPP
@@ -0,0 +1,28 @@
+//===- lib/uri/host.hpp -----------------------------------*- mode: C++ -*-===//
+//*  _               _    *
+//* | |__   ___  ___| |_  *
+//* | '_ \ / _ \/ __| __| *
+//* | | | | (_) \__ \ |_  *
+//* |_| |_|\___/|___/\__| *
+//*                       *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file host.hpp
+/// \brief Access to split()'s host production from elsewhere in the library.
+#ifndef URI_HOST_HPP
+#define URI_HOST_HPP
+
+#include <string_view>
+
+namespace uri::details {
+
+/// Returns true if the whole of \p host matches the host production used by
+/// split(): `IP-literal / IPv4address / reg-name`.
+bool is_host (std::string_view host);
+
+}  // end namespace uri::details
+
+#endif  // URI_HOST_HPP
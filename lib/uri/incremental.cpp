@@ -0,0 +1,442 @@
+//===- lib/uri/incremental.cpp --------------------------------------------===//
+//*  _                                          _        _  *
+//* (_)_ __   ___ _ __ ___ _ __ ___   ___ _ __ | |_ __ _| | *
+//* | | '_ \ / __| '__/ _ \ '_ ` _ \ / _ \ '_ \| __/ _` | | *
+//* | | | | | (__| | |  __/ | | | | |  __/ | | | || (_| | | *
+//* |_|_| |_|\___|_|  \___|_| |_| |_|\___|_| |_|\__\__,_|_| *
+//*                                                         *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/incremental.hpp"
+
+#include <cassert>
+#include <utility>
+
+#include "uri/grammar.hpp"
+
+#include "char_classes.hpp"
+#include "host.hpp"
+
+namespace g = uri::grammar;
+
+namespace uri {
+
+using details::digit_char;
+using details::hex_char;
+using details::is;
+using details::literal_char;
+using details::nc_char;
+using details::pchar;
+using details::query_char;
+using details::reg_char;
+using details::scheme_char;
+using details::skip;
+
+incremental_parser::incremental_parser (callback cb,
+                                        std::size_t const max_length)
+    : callback_{std::move (cb)}, max_length_{max_length} {
+}
+
+void incremental_parser::reset () {
+  input_.clear ();
+  state_ = state::start;
+  pct_ = 0;
+  first_ = 0;
+  host_first_ = 0;
+  colon_ = 0;
+  colons_ = 0;
+  ip_literal_ = false;
+  digits_ = true;
+  scheme_.reset ();
+  userinfo_.reset ();
+  host_.reset ();
+  port_.reset ();
+  absolute_ = false;
+  segments_.clear ();
+  query_.reset ();
+  fragment_.reset ();
+}
+
+bool incremental_parser::fail () {
+  state_ = state::failed;
+  return false;
+}
+
+void incremental_parser::report (component const c, span const s) const {
+  if (callback_) {
+    callback_ (c, view (s));
+  }
+}
+
+void incremental_parser::end_segment (std::size_t const pos) {
+  segments_.push_back (span{first_, pos});
+  this->report (component::segment, segments_.back ());
+}
+
+bool incremental_parser::end_authority (std::size_t const pos) {
+  auto host = span{host_first_, pos};
+  if (colons_ > 0) {
+    // The characters following the last colon are the port.
+    if (colons_ > 1 || !digits_) {
+      return false;
+    }
+    host.last = colon_;
+    port_ = span{colon_ + 1, pos};
+  }
+  // A reg-name is fully checked by the character classes but an IP-literal
+  // or anything that might be an IPv4 address must be checked as a whole.
+  // Hosts are short so this second look at their characters is cheap and it
+  // ensures that the parser accepts exactly the same hosts as split().
+  if (auto const h = view (host);
+      !h.empty () && (h.front () == '[' || g::digit::test (h.front ())) &&
+      !details::is_host (h)) {
+    return false;
+  }
+  host_ = host;
+  this->report (component::host, host);
+  if (port_) {
+    this->report (component::port, *port_);
+  }
+  return true;
+}
+
+bool incremental_parser::feed (std::string_view const chunk) {
+  if (state_ == state::failed || state_ == state::finished) {
+    return false;
+  }
+  if (chunk.size () > max_length_ - input_.size ()) {
+    return this->fail ();
+  }
+  auto pos = input_.size ();
+  input_.append (chunk);
+  auto const size = input_.size ();
+
+  // Starts the query or fragment component if c is "?" or "#".
+  auto const begin_query_or_fragment = [this] (char const c,
+                                               std::size_t const p) {
+    if (c == '?') {
+      state_ = state::query;
+    } else if (c == '#') {
+      state_ = state::fragment;
+    } else {
+      return false;
+    }
+    first_ = p + 1;
+    return true;
+  };
+
+  while (pos < size) {
+    if (pct_ > 0) {
+      // The hex digits of a pct-encoded triplet.
+      if (!is (input_[pos], hex_char)) {
+        return this->fail ();
+      }
+      --pct_;
+      ++pos;
+      continue;
+    }
+    switch (state_) {
+    case state::start: {
+      auto const c = input_[pos];
+      first_ = pos;
+      if (g::alpha::test (c)) {
+        state_ = state::scheme;
+      } else if (is (c, nc_char) || c == '%') {
+        state_ = state::segment_nc;
+      } else if (c == '/') {
+        state_ = state::solidus;
+        ++pos;
+      } else if (begin_query_or_fragment (c, pos)) {
+        ++pos;
+      } else {
+        return this->fail ();
+      }
+    } break;
+
+    case state::scheme:
+      pos = skip (input_, pos, scheme_char);
+      if (pos < size) {
+        if (input_[pos] == ':') {
+          scheme_ = span{first_, pos};
+          this->report (component::scheme, *scheme_);
+          state_ = state::hier_part;
+          ++pos;
+        } else {
+          // This wasn't a scheme after all: it's the first segment of a
+          // relative-ref.
+          state_ = state::segment_nc;
+        }
+      }
+      break;
+
+    case state::segment_nc:
+      pos = skip (input_, pos, nc_char);
+      if (pos < size) {
+        auto const c = input_[pos];
+        if (c == '%') {
+          pct_ = 2;
+        } else if (c == '/') {
+          this->end_segment (pos);
+          first_ = pos + 1;
+          state_ = state::segment;
+        } else if (c == '?' || c == '#') {
+          this->end_segment (pos);
+          begin_query_or_fragment (c, pos);
+        } else {
+          return this->fail ();
+        }
+        ++pos;
+      }
+      break;
+
+    case state::hier_part: {
+      auto const c = input_[pos];
+      if (c == '/') {
+        state_ = state::solidus;
+        ++pos;
+      } else if (begin_query_or_fragment (c, pos)) {
+        ++pos;
+      } else if (is (c, pchar) || c == '%') {
+        // path-rootless
+        first_ = pos;
+        state_ = state::segment;
+      } else {
+        return this->fail ();
+      }
+    } break;
+
+    case state::solidus:
+      if (input_[pos] == '/') {
+        // "//" authority
+        first_ = pos + 1;
+        host_first_ = first_;
+        state_ = state::authority;
+        ++pos;
+      } else {
+        // path-absolute
+        absolute_ = true;
+        first_ = pos;
+        state_ = state::segment;
+      }
+      break;
+
+    case state::authority:
+      if (ip_literal_) {
+        pos = skip (input_, pos, literal_char);
+        if (pos < size) {
+          if (input_[pos] != ']') {
+            return this->fail ();
+          }
+          ip_literal_ = false;
+          state_ = state::authority_end;
+          ++pos;
+        }
+        break;
+      }
+      // The characters before an "@" are the userinfo; after it are the
+      // host and port. Until we see an "@" (or the end of the authority) we
+      // don't know which we're looking at.
+      {
+        auto const literal = host_first_ < size && input_[host_first_] == '[';
+        auto const host_known = userinfo_.has_value () || literal;
+        for (; pos < size && is (input_[pos], reg_char); ++pos) {
+          if (!is (input_[pos], digit_char)) {
+            if (host_known && colons_ > 0) {
+              return this->fail ();  // A bad port.
+            }
+            digits_ = false;
+          }
+        }
+        if (pos >= size) {
+          break;
+        }
+        auto const c = input_[pos];
+        switch (c) {
+        case '%':
+          pct_ = 2;
+          digits_ = false;
+          break;
+        case ':':
+          if (host_known && colons_ > 0) {
+            return this->fail ();
+          }
+          ++colons_;
+          colon_ = pos;
+          digits_ = true;
+          break;
+        case '@':
+          if (host_known) {
+            return this->fail ();
+          }
+          userinfo_ = span{first_, pos};
+          this->report (component::userinfo, *userinfo_);
+          host_first_ = pos + 1;
+          colons_ = 0;
+          digits_ = true;
+          break;
+        case '[':
+          if (pos != host_first_) {
+            return this->fail ();
+          }
+          ip_literal_ = true;
+          break;
+        case '/':
+        case '?':
+        case '#':
+          if (!this->end_authority (pos)) {
+            return this->fail ();
+          }
+          if (c == '/') {
+            // path-abempty
+            absolute_ = true;
+            first_ = pos + 1;
+            state_ = state::segment;
+          } else {
+            begin_query_or_fragment (c, pos);
+          }
+          break;
+        default: return this->fail ();
+        }
+        ++pos;
+      }
+      break;
+
+    case state::authority_end: {
+      auto const c = input_[pos];
+      if (c == ':') {
+        colons_ = 1;
+        colon_ = pos;
+        digits_ = true;
+        state_ = state::authority;
+        ++pos;
+      } else if (c == '/' || c == '?' || c == '#') {
+        // Let the authority state finish the authority.
+        state_ = state::authority;
+      } else {
+        return this->fail ();
+      }
+    } break;
+
+    case state::segment:
+      pos = skip (input_, pos, pchar);
+      if (pos < size) {
+        auto const c = input_[pos];
+        if (c == '%') {
+          pct_ = 2;
+        } else if (c == '/') {
+          this->end_segment (pos);
+          first_ = pos + 1;
+        } else if (c == '?' || c == '#') {
+          this->end_segment (pos);
+          begin_query_or_fragment (c, pos);
+        } else {
+          return this->fail ();
+        }
+        ++pos;
+      }
+      break;
+
+    case state::query:
+      pos = skip (input_, pos, query_char);
+      if (pos < size) {
+        auto const c = input_[pos];
+        if (c == '%') {
+          pct_ = 2;
+        } else if (c == '#') {
+          query_ = span{first_, pos};
+          this->report (component::query, *query_);
+          begin_query_or_fragment (c, pos);
+        } else {
+          return this->fail ();
+        }
+        ++pos;
+      }
+      break;
+
+    case state::fragment:
+      pos = skip (input_, pos, query_char);
+      if (pos < size) {
+        if (input_[pos] != '%') {
+          return this->fail ();
+        }
+        pct_ = 2;
+        ++pos;
+      }
+      break;
+
+    case state::finished:
+    case state::failed: assert (false); return false;
+    }
+  }
+  return true;
+}
+
+bool incremental_parser::end_input () {
+  if (pct_ > 0) {
+    return false;
+  }
+  auto const size = input_.size ();
+  switch (state_) {
+  case state::start:
+  case state::hier_part: break;
+  case state::scheme:
+  case state::segment_nc:
+  case state::segment: this->end_segment (size); break;
+  case state::solidus:
+    // A path consisting of a single "/".
+    absolute_ = true;
+    first_ = size;
+    this->end_segment (size);
+    break;
+  case state::authority:
+    if (ip_literal_) {
+      return false;
+    }
+    return this->end_authority (size);
+  case state::authority_end: return this->end_authority (size);
+  case state::query:
+    query_ = span{first_, size};
+    this->report (component::query, *query_);
+    break;
+  case state::fragment:
+    fragment_ = span{first_, size};
+    this->report (component::fragment, *fragment_);
+    break;
+  case state::finished:
+  case state::failed: return false;
+  }
+  return true;
+}
+
+std::optional<parts> incremental_parser::finish () {
+  if (!this->end_input ()) {
+    this->fail ();
+    return {};
+  }
+  state_ = state::finished;
+
+  parts result;
+  auto const view_of = [this] (std::optional<span> const& s) {
+    return s ? std::optional<std::string_view>{view (*s)} : std::nullopt;
+  };
+  result.scheme = view_of (scheme_);
+  if (host_) {
+    auto& auth = result.ensure_authority ();
+    auth.userinfo = view_of (userinfo_);
+    auth.host = view (*host_);
+    auth.port = view_of (port_);
+  }
+  result.path.absolute = absolute_;
+  result.path.segments.reserve (segments_.size ());
+  for (auto const& s : segments_) {
+    result.path.segments.push_back (view (s));
+  }
+  result.query = view_of (query_);
+  result.fragment = view_of (fragment_);
+  return result;
+}
+
+}  // end namespace uri
@@ -0,0 +1,275 @@
+//===- lib/uri/pctdecode.cpp ----------------------------------------------===//
+//*             _      _                    _       *
+//*  _ __   ___| |_ __| | ___  ___ ___   __| | ___  *
+//* | '_ \ / __| __/ _` |/ _ \/ __/ _ \ / _` |/ _ \ *
+//* | |_) | (__| || (_| |  __/ (_| (_) | (_| |  __/ *
+//* | .__/ \___|\__\__,_|\___|\___\___/ \__,_|\___| *
+//* |_|                                             *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/pctdecode.hpp"
+
+#include "simd.hpp"
+#include "utf8.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <tuple>
+#include <utility>
+
+namespace {
+
+/// Decodes the percent-encoded range [first, last) writing the result to
+/// \p out. \p out may be equal to \p first (the output is never longer than
+/// the input so it never overtakes the input). Decoding stops once the input
+/// reaches \p limit (an escape which starts before \p limit is decoded in
+/// full).
+///
+/// \returns A pair containing the input position at which decoding stopped
+///   and the end of the output.
+std::pair<char const*, char*> decode (char const* first,
+                                      char const* const limit,
+                                      char const* const last,
+                                      char* out) noexcept {
+  assert (limit <= last);
+  while (first < limit) {
+    // Copy the literal run up to the next '%' in bulk.
+    auto const* const pct = uri::simd::find (first, limit, '%');
+    if (out != first) {
+      std::memmove (out, first, static_cast<std::size_t> (pct - first));
+    }
+    out += pct - first;
+    first = pct;
+    if (pct == limit) {
+      break;
+    }
+    if (last - first >= 3) {
+      auto const nhi = uri::details::hex_value (*(first + 1));
+      auto const nlo = uri::details::hex_value (*(first + 2));
+      if (!uri::details::either_bad (nhi, nlo)) {
+        *(out++) = static_cast<char> ((nhi << 4U) | nlo);
+        first += 3;
+        continue;
+      }
+    }
+    // Not a valid escape: the '%' is passed through unchanged.
+    *(out++) = *(first++);
+  }
+  return std::make_pair (first, out);
+}
+
+char* decode (char const* const first, char const* const last,
+              char* const out) noexcept {
+  return decode (first, last, last, out).second;
+}
+
+/// Returns the offset within the percent-encoded input [first, last) of the
+/// character that produced decoded byte number \p n.
+std::size_t input_offset (char const* const first, char const* const last,
+                          std::size_t n) noexcept {
+  auto const* pos = first;
+  for (;;) {
+    auto const* const pct = uri::simd::find (pos, last, '%');
+    auto const run = static_cast<std::size_t> (pct - pos);
+    if (n <= run) {
+      return static_cast<std::size_t> (pos - first) + n;
+    }
+    n -= run;
+    pos = pct;
+    assert (pos != last);
+    pos += uri::details::is_escape (
+             std::string_view{pos, static_cast<std::size_t> (last - pos)}, 0)
+             ? 3
+             : 1;
+    --n;
+  }
+}
+
+/// Returns the offset of the first byte of the first ill-formed UTF-8 sequence
+/// in the decoded text [first, last). \p valid marks a point before which the
+/// text is known to be valid except that it may end with an incomplete
+/// sequence.
+std::size_t find_bad_utf8 (char const* const first, char const* valid,
+                           char const* const last) noexcept {
+  // Back up to the start of the sequence which includes the byte before
+  // 'valid'.
+  if (valid != first) {
+    do {
+      --valid;
+    } while (valid != first && uri::utf8::is_continuation (*valid));
+  }
+  auto const valid_offset = static_cast<std::size_t> (valid - first);
+  uri::utf8::validator v;
+  [[maybe_unused]] auto const ok = v.run (valid, last, valid_offset);
+  assert (!ok || !v.complete ());
+  return v.start ();
+}
+
+}  // end anonymous namespace
+
+namespace uri {
+
+std::string pctdecode (std::string_view const s) {
+  // The decoded string can never be longer than the input so the result is
+  // sized once and trimmed at the end.
+  std::string result;
+  result.resize (s.length ());
+  auto const* const first = s.data ();
+  auto* const out = decode (first, first + s.length (), result.data ());
+  result.resize (static_cast<std::size_t> (out - result.data ()));
+  return result;
+}
+
+char* pctdecode_inplace (char* const first, char* const last) noexcept {
+  return decode (first, last, first);
+}
+
+std::string& pctdecode_inplace (std::string& s) {
+  auto* const first = s.data ();
+  s.resize (static_cast<std::size_t> (
+    pctdecode_inplace (first, first + s.length ()) - first));
+  return s;
+}
+
+// pctdecode error category
+// ~~~~~~~~~~~~~~~~~~~~~~~~
+char const* pctdecode_error_category::name () const noexcept {
+  return "pctdecode";
+}
+std::string pctdecode_error_category::message (int error) const {
+  auto const* m = "unknown error";
+  switch (static_cast<pctdecode_error_code> (error)) {
+  case pctdecode_error_code::bad_escape: m = "bad escape"; break;
+  case pctdecode_error_code::truncated_escape: m = "truncated escape"; break;
+  case pctdecode_error_code::nul: m = "NUL character"; break;
+  case pctdecode_error_code::bad_utf8: m = "bad UTF-8"; break;
+  case pctdecode_error_code::none: m = "unknown error"; break;
+  }
+  return m;
+}
+std::error_code make_error_code (pctdecode_error_code const e) {
+  static pctdecode_error_category category;
+  return {static_cast<int> (e), category};
+}
+
+// pctdecode strict
+// ~~~~~~~~~~~~~~~~
+pctdecode_strict_result pctdecode_strict (std::string_view const s,
+                                          pctdecode_checks const checks) {
+  auto const* const first = s.data ();
+  auto const* const last = first + s.length ();
+  auto const offset = [first] (char const* const pos) {
+    return static_cast<std::size_t> (pos - first);
+  };
+  auto const error = [] (pctdecode_error_code const code,
+                         std::size_t const at) {
+    return pctdecode_error{make_error_code (code), at};
+  };
+
+  std::string result;
+  result.resize (s.length ());
+  auto* out = result.data ();
+  utf8::validator utf8;
+  for (auto const* pos = first; pos != last;) {
+    // Find the end of the literal run. If NUL characters are being rejected,
+    // the run also stops at the first of those.
+    auto const* const stop = checks.nul ? simd::find (pos, last, '%', '\0')
+                                        : simd::find (pos, last, '%');
+    if (checks.utf8 && !utf8.run (pos, stop, offset (pos))) {
+      return error (pctdecode_error_code::bad_utf8, utf8.start ());
+    }
+    std::memcpy (out, pos, static_cast<std::size_t> (stop - pos));
+    out += stop - pos;
+    pos = stop;
+    if (pos == last) {
+      break;
+    }
+    if (*pos == '\0') {
+      return error (pctdecode_error_code::nul, offset (pos));
+    }
+    // An escape is "truncated" if the characters that are present are valid
+    // hex digits but there are too few of them.
+    auto const* const escape_end =
+      pos + std::min (last - pos, std::ptrdiff_t{3});
+    if (std::any_of (pos + 1, escape_end, [] (char const c) {
+          return details::hex_value (c) == details::bad;
+        })) {
+      return error (pctdecode_error_code::bad_escape, offset (pos));
+    }
+    if (escape_end - pos < 3) {
+      return error (pctdecode_error_code::truncated_escape, offset (pos));
+    }
+    auto const c =
+      static_cast<unsigned char> ((details::hex_value (*(pos + 1)) << 4U) |
+                                  details::hex_value (*(pos + 2)));
+    if (checks.nul && c == 0U) {
+      return error (pctdecode_error_code::nul, offset (pos));
+    }
+    if (checks.utf8 && !utf8.step (c, offset (pos))) {
+      return error (pctdecode_error_code::bad_utf8, utf8.start ());
+    }
+    *(out++) = static_cast<char> (c);
+    pos += 3;
+  }
+  if (checks.utf8 && !utf8.complete ()) {
+    return error (pctdecode_error_code::bad_utf8, utf8.start ());
+  }
+  result.resize (static_cast<std::size_t> (out - result.data ()));
+  return result;
+}
+
+// pctdecode utf8
+// ~~~~~~~~~~~~~~
+pctdecode_strict_result pctdecode_utf8 (std::string_view const s) {
+  auto const* const first = s.data ();
+  auto const* const last = first + s.length ();
+  std::string result;
+  result.resize (s.length ());
+  auto* const out_first = result.data ();
+  auto const error = [&] (char const* const out_last, char const* valid) {
+    auto const n = find_bad_utf8 (out_first, valid, out_last);
+    return pctdecode_error{make_error_code (pctdecode_error_code::bad_utf8),
+                           input_offset (first, last, n)};
+  };
+
+  auto* out = out_first;
+#if URI_SIMD_SSE2
+  if (simd::has_ssse3 ()) {
+    // The input is decoded in chunks. Each chunk's output is validated while
+    // it is still in cache.
+    static constexpr auto chunk_size = std::ptrdiff_t{4096};
+    utf8::block_validator validator;
+    char const* validated = out_first;
+    for (auto const* pos = first; pos != last;) {
+      auto const* const valid = validated;
+      std::tie (pos, out) = decode (
+        pos, pos + std::min (last - pos, chunk_size), last, out);
+      for (; out - validated >= static_cast<std::ptrdiff_t> (simd::block_size);
+           validated += simd::block_size) {
+        validator.block (simd::load (validated));
+      }
+      if (validator.has_error ()) {
+        return error (out, valid);
+      }
+    }
+    validator.finish (validated, out);
+    if (validator.has_error ()) {
+      return error (out, validated);
+    }
+    result.resize (static_cast<std::size_t> (out - out_first));
+    return result;
+  }
+#endif  // URI_SIMD_SSE2
+  out = decode (first, last, out_first);
+  if (utf8::validator v; !v.run (out_first, out, 0) || !v.complete ()) {
+    return error (out, out_first);
+  }
+  result.resize (static_cast<std::size_t> (out - out_first));
+  return result;
+}
+
+}  // end namespace uri
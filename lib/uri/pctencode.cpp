@@ -12,103 +12,238 @@
 //===----------------------------------------------------------------------===//
 #include "uri/pctencode.hpp"
 
+#include "simd.hpp"
+
+#if URI_SIMD_SSE2
+#include <tmmintrin.h>
+#endif
+
 namespace {
 
-enum code_points {
-  space = 0x20,
-  exclamation_mark = 0x21,
-  digit_zero = 0x30,
-  digit_nine = 0x39,
-  latin_capital_letter_a = 0x41,
-  latin_capital_letter_z = 0x5A,
-  latin_small_letter_a = 0x61,
-  latin_small_letter_z = 0x7A,
-  tilde = 0x7E,
-};
+using uri::pctencode_set;
 
-}  // end anonymous namespace
+// The encode sets in the order of their bit positions, preceded by "none".
+constexpr std::array<pctencode_set, 8> all_sets{{
+  pctencode_set::none,
+  pctencode_set::fragment,
+  pctencode_set::query,
+  pctencode_set::special_query,
+  pctencode_set::path,
+  pctencode_set::userinfo,
+  pctencode_set::component,
+  pctencode_set::form_urlencoded,
+}};
 
-namespace uri {
+/// Returns the index of \p es in all_sets or all_sets.size() if it is not a
+/// single encode set.
+constexpr std::size_t set_index (pctencode_set const es) noexcept {
+  for (auto ctr = std::size_t{0}; ctr < all_sets.size (); ++ctr) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    if (all_sets[ctr] == es) {
+      return ctr;
+    }
+  }
+  return all_sets.size ();
+}
 
-bool needs_pctencode (std::uint_least8_t c, pctencode_set es) noexcept {
-  static std::array<std::uint8_t const, 32> const encode{{
-    0b0100'0000,  // U+0021 EXCLAMATION MARK
-    0b0111'1111,  // U+0022 QUOTATION MARK
-    0b0111'1110,  // U+0023 NUMBER SIGN
-    0b0110'0000,  // U+0024 DOLLAR SIGN
-    0b1111'1111,  // U+0025 PERCENT SIGN
-    0b0110'0000,  // U+0026 AMPERSAND
-    0b0100'0100,  // U+0027 APOSTROPHE
-    0b0100'0000,  // U+0028 LEFT PARENTHESIS
-    0b0100'0000,  // U+0029 RIGHT PARENTHESIS
-    0b0000'0000,  // U+002A ASTERISK
-    0b0110'0000,  // U+002B PLUS SIGN
-    0b0110'0000,  // U+002C COMMA
-    0b0000'0000,  // U+002D HYPHEN MINUS
-    0b0000'0000,  // U+002E FULL STOP
-    0b0111'0000,  // U+002F SOLIDUS
-    // U+0030 DIGIT ZERO to U+0039 DIGIT NINE removed.
-    0b0111'0000,  // U+003A (:)
-    0b0111'0000,  // U+003B (;)
-    0b0111'1111,  // U+003C (<)
-    0b0111'0000,  // U+003D (=)
-    0b0111'1111,  // U+003E (>)
-    0b0111'1000,  // U+003F (?)
-    0b0111'0000,  // U+0040 (@)
-    // U+0041 LATIN CAPITAL LETTER A to U+005A LATIN CAPITAL LETTER Z removed.
-    0b0111'0000,  // U+005B ([ LEFT SQUARE BRACKET)
-    0b0111'0000,  // U+005C (\ REVERSE SOLIDUS)
-    0b0111'0000,  // U+005D (] RIGHT SWUARE BRACKET)
-    0b0111'0000,  // U+005E (^ CIRCUMFLEX ACCENT)
-    0b0000'0000,  // U+005F LOW LINE
-    0b0111'1000,  // U+0060 GRAVE ACCENT
-    // U+0061 LATIN SMALL LETTER A to U+007A LATIN SMALL LETTER Z removed.
-    0b0111'1000,  // U+007B LEFT CURLY BRACKET
-    0b0111'0000,  // U+007C VERTICAL LINE
-    0b0111'1000,  // U+007D RIGHT CURLY BRACKET
-    0b0100'0000,  // U+007E TILDE
+// The scalar lookup tables for each of the sets in all_sets.
+using uri::details::pctencode_table;
+constexpr std::array<std::array<bool, 256> const*, all_sets.size ()>
+  lookup_tables{{
+    &pctencode_table<pctencode_set::none>,
+    &pctencode_table<pctencode_set::fragment>,
+    &pctencode_table<pctencode_set::query>,
+    &pctencode_table<pctencode_set::special_query>,
+    &pctencode_table<pctencode_set::path>,
+    &pctencode_table<pctencode_set::userinfo>,
+    &pctencode_table<pctencode_set::component>,
+    &pctencode_table<pctencode_set::form_urlencoded>,
   }};
-  constexpr auto num_digits = 10;
-  constexpr auto num_alpha = 26;
-  // Code point of the first entry in the table.
-  constexpr auto table_first = exclamation_mark;
-  constexpr auto capital_letter_adjustment = table_first + num_digits;
-  constexpr auto small_letter_adjustment = table_first + num_digits + num_alpha;
-
-  if (c <= space || c > tilde) {
-    return true;
-  }
-  c -= table_first;  // C0 control codes were removed.
-  if (c >= digit_zero - table_first) {
-    if (c <= digit_nine - table_first) {
-      return false;
+
+// Each byte is classified by splitting it into two nibbles. Entry 'lo' of a
+// set's low-nibble table has bit 'hi' set if the byte (hi << 4) | lo must be
+// encoded. The high-nibble table maps 'hi' to the bit for that row. Every code
+// unit from 0x80 must be encoded: these rows map to all bits which works
+// because each low-nibble entry is non-zero (the C0 controls are always
+// encoded).
+using nibble_table = std::array<std::uint8_t, 16>;
+
+constexpr auto low_nibble_tables = [] {
+  std::array<nibble_table, all_sets.size ()> tables{};
+  for (auto set = std::size_t{0}; set < all_sets.size (); ++set) {
+    for (auto lo = 0U; lo < 16U; ++lo) {
+      auto bits = 0U;
+      for (auto hi = 0U; hi < 8U; ++hi) {
+        if (uri::details::in_pctencode_set (
+              static_cast<std::uint_least8_t> ((hi << 4U) | lo),
+              all_sets[set])) {
+          bits |= 1U << hi;
+        }
+      }
+      tables[set][lo] = static_cast<std::uint8_t> (bits);
     }
-    c -= num_digits;  // The digits are missing from the table.
   }
-  if (c >= latin_capital_letter_a - capital_letter_adjustment) {
-    if (c <= latin_capital_letter_z - capital_letter_adjustment) {
-      return false;  // A latin capital letter.
+  return tables;
+}();
+constexpr nibble_table high_nibble_table{{0x01, 0x02, 0x04, 0x08, 0x10, 0x20,
+                                          0x40, 0x80, 0xFF, 0xFF, 0xFF, 0xFF,
+                                          0xFF, 0xFF, 0xFF, 0xFF}};
+
+#if URI_SIMD_SSE2
+/// Returns a mask with bit n set if byte n of \p block must be encoded given
+/// the low- and high-nibble tables.
+URI_SIMD_TARGET_SSSE3 inline std::uint32_t unsafe_mask (__m128i const block,
+                                                        __m128i const lo_lut,
+                                                        __m128i const hi_lut) {
+  auto const nibble_mask = _mm_set1_epi8 (0x0F);
+  auto const lo_bits =
+    _mm_shuffle_epi8 (lo_lut, _mm_and_si128 (block, nibble_mask));
+  auto const hi_bits = _mm_shuffle_epi8 (
+    hi_lut, _mm_and_si128 (_mm_srli_epi16 (block, 4), nibble_mask));
+  // A byte of 'safe' is 0xFF if the corresponding code unit can be copied
+  // as-is.
+  auto const safe =
+    _mm_cmpeq_epi8 (_mm_and_si128 (lo_bits, hi_bits), _mm_setzero_si128 ());
+  return static_cast<std::uint32_t> (_mm_movemask_epi8 (safe)) ^ 0xFFFFU;
+}
+
+/// Returns a pointer to the first code unit in [first, last) which must be
+/// encoded. Only whole 16 byte blocks are examined: if all of them are safe the
+/// result points at the partial block remaining at the end of the range.
+URI_SIMD_TARGET_SSSE3 char const* find_pctencode_ssse3 (
+  char const* first, char const* const last, nibble_table const& lo_table) {
+  auto const lo_lut = uri::simd::load (lo_table.data ());
+  auto const hi_lut = uri::simd::load (high_nibble_table.data ());
+  for (; static_cast<std::size_t> (last - first) >= uri::simd::block_size;
+       first += uri::simd::block_size) {
+    if (auto const mask = unsafe_mask (uri::simd::load (first), lo_lut, hi_lut);
+        mask != 0U) {
+      return first + uri::simd::countr_zero (mask);
     }
-    c -= num_alpha;  // Upper-case letters are missing from the table.
   }
-  if (c >= latin_small_letter_a - small_letter_adjustment) {
-    if (c <= latin_small_letter_z - small_letter_adjustment) {
-      return false;  // A latin lower-case letter.
-    }
-    c -= num_alpha;  // Lower-case letters are missing.
+  return first;
+}
+
+/// Counts the code units which must be encoded in the whole 16 byte blocks at
+/// the start of [*first, last). On return, *first points to the partial block
+/// remaining at the end of the range.
+URI_SIMD_TARGET_SSSE3 std::size_t count_pctencode_ssse3 (
+  char const** const first, char const* const last,
+  nibble_table const& lo_table) {
+  auto const lo_lut = uri::simd::load (lo_table.data ());
+  auto const hi_lut = uri::simd::load (high_nibble_table.data ());
+  auto count = std::size_t{0};
+  auto const* pos = *first;
+  for (; static_cast<std::size_t> (last - pos) >= uri::simd::block_size;
+       pos += uri::simd::block_size) {
+    count += uri::simd::popcount (
+      unsafe_mask (uri::simd::load (pos), lo_lut, hi_lut));
   }
-  if (c >= encode.size ()) {
-    return false;
+  *first = pos;
+  return count;
+}
+#endif  // URI_SIMD_SSE2
+
+/// Returns a pointer to the first code unit in [first, last) which must be
+/// encoded with the encode set \p es or \p last if there is none.
+char const* find_pctencode (char const* first, char const* const last,
+                            pctencode_set const es) noexcept {
+  auto const index = set_index (es);
+  if (index >= all_sets.size ()) {
+    return std::find_if (first, last, [es] (char const c) {
+      return uri::details::in_pctencode_set (
+        static_cast<std::uint_least8_t> (c), es);
+    });
   }
   // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
-  return (encode[c] &
-          static_cast<std::underlying_type_t<pctencode_set>> (es)) != 0U;
+  auto const& table = *lookup_tables[index];
+  auto const is_unsafe = [&table] (char const c) {
+    return table[static_cast<unsigned char> (c)];
+  };
+  // Escapes often come in clusters (think of a multi-byte UTF-8 sequence) so
+  // check the first code unit before starting a vector search.
+  if (first == last || is_unsafe (*first)) {
+    return first;
+  }
+#if URI_SIMD_SSE2
+  if (uri::simd::has_ssse3 ()) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    first = find_pctencode_ssse3 (first, last, low_nibble_tables[index]);
+  }
+#endif  // URI_SIMD_SSE2
+  return std::find_if (first, last, is_unsafe);
+}
+
+/// Returns the number of code units in [first, last) which must be encoded
+/// with the encode set \p es.
+std::size_t count_pctencode (char const* first, char const* const last,
+                             pctencode_set const es) noexcept {
+  auto const index = set_index (es);
+  if (index >= all_sets.size ()) {
+    return static_cast<std::size_t> (
+      std::count_if (first, last, [es] (char const c) {
+        return uri::details::in_pctencode_set (
+          static_cast<std::uint_least8_t> (c), es);
+      }));
+  }
+  auto count = std::size_t{0};
+#if URI_SIMD_SSE2
+  if (uri::simd::has_ssse3 ()) {
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    count = count_pctencode_ssse3 (&first, last, low_nibble_tables[index]);
+  }
+#endif  // URI_SIMD_SSE2
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+  auto const& table = *lookup_tables[index];
+  return count + static_cast<std::size_t> (
+                   std::count_if (first, last, [&table] (char const c) {
+                     return table[static_cast<unsigned char> (c)];
+                   }));
+}
+
+}  // end anonymous namespace
+
+namespace uri {
+
+bool needs_pctencode (std::uint_least8_t c, pctencode_set es) noexcept {
+  return details::in_pctencode_set (c, es);
 }
 
 bool needs_pctencode (std::string_view s, pctencode_set es) {
-  return std::any_of (std::begin (s), std::end (s), [es] (auto c) {
-    return needs_pctencode (static_cast<std::uint_least8_t> (c), es);
-  });
+  auto const* const last = s.data () + s.length ();
+  return find_pctencode (s.data (), last, es) != last;
+}
+
+std::size_t pctencoded_length (std::string_view s, pctencode_set encodeset) {
+  auto const* const first = s.data ();
+  // Each code unit which is encoded adds two characters.
+  return s.length () + 2U * count_pctencode (first, first + s.length (),
+                                             encodeset);
+}
+
+std::string pctencode (std::string_view s, pctencode_set encodeset) {
+  // A counting pass establishes the exact length of the result so that it can
+  // be allocated once. The encoded text is then written straight into it.
+  std::string result;
+  result.resize (pctencoded_length (s, encodeset));
+  auto* out = result.data ();
+  auto const* pos = s.data ();
+  auto const* const last = pos + s.length ();
+  for (;;) {
+    // Copy the run of code units which don't need to be encoded in bulk.
+    auto const* const unsafe = find_pctencode (pos, last, encodeset);
+    out = std::copy (pos, unsafe, out);
+    if (unsafe == last) {
+      break;
+    }
+    auto const cu = static_cast<std::uint_least8_t> (*unsafe);
+    *(out++) = '%';
+    *(out++) = dec2hex ((cu >> 4U) & 0xFU);
+    *(out++) = dec2hex (cu & 0xFU);
+    pos = unsafe + 1;
+  }
+  assert (out == result.data () + result.size ());
+  return result;
 }
 
 }  // end namespace uri
@@ -12,6 +12,15 @@
 //===----------------------------------------------------------------------===//
 #include "uri/punycode.hpp"
 
+#include "simd.hpp"
+#include "utf8.hpp"
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
 namespace {
 
 // returns the numeric value of a basic code point (for use in representing
@@ -65,47 +74,68 @@ decode_vli (Iterator first, Iterator last, std::string::size_type vli,
   return std::make_tuple (vli, first);
 }
 
-}  // end anonymous namespace
+/// Pointers to the working storage used by decode_into(). Each array must
+/// have at least as many elements as there are characters in the input.
+struct decode_scratch {
+  char32_t* code_points;      ///< The decoded non-basic code points.
+  std::uint32_t* positions;   ///< The index at which each was inserted.
+  std::uint32_t* tree;        ///< A Fenwick tree counting free output slots.
+  bool* used;                 ///< Output slots filled by non-basic code points.
+};
 
-namespace uri::punycode {
-
-char const* error_category::name () const noexcept {
-  return "punycode decode";
-}
-std::string error_category::message (int error) const {
-  auto const* m = "unknown error";
-  switch (static_cast<decode_error_code> (error)) {
-  case decode_error_code::bad_input: m = "bad input"; break;
-  case decode_error_code::overflow: m = "overflow"; break;
-  case decode_error_code::none: m = "unknown error"; break;
+/// Returns the index of the slot which is number \p k (counting from zero) of
+/// those which are still free. \p tree is a Fenwick tree of \p size elements
+/// in which each free slot counts one.
+std::size_t find_free_slot (std::uint32_t const* const tree,
+                            std::size_t const size, std::size_t k) noexcept {
+  auto step = std::size_t{1};
+  while (step * 2U <= size) {
+    step *= 2U;
   }
-  return m;
-}
-std::error_code make_error_code (decode_error_code const e) {
-  static error_category category;
-  return {static_cast<int> (e), category};
+  auto index = std::size_t{0};
+  ++k;
+  for (; step > 0U; step /= 2U) {
+    if (index + step <= size && tree[index + step - 1U] < k) {
+      index += step;
+      k -= tree[index - 1U];
+    }
+  }
+  return index;
 }
 
-decode_result decode (std::string_view const& input) {
-  std::u32string output;
+/// Decodes the punycode \p input writing the code points to [first, last).
+///
+/// The RFC 3492 algorithm inserts each decoded code point into the output at
+/// the position given by its variable-length integer. Doing so directly shifts
+/// the tail of the output every time and is quadratic. Instead, the code
+/// points and their insertion indices are recorded and then placed in
+/// reverse order: the code point inserted last lands in free slot i of the
+/// final output and each earlier one lands in slot i of those slots that are
+/// still free. The basic code points fill the remaining slots in order.
+std::variant<std::error_code, char32_t*> decode_into (
+  std::string_view const& input, decode_scratch const& scratch,
+  char32_t* const first, char32_t* const last) {
   static constexpr auto maxint =
     std::numeric_limits<std::uint_least32_t>::max ();
-  using details::adapt;
-  using details::delimiter;
-  using details::initial_bias;
-  using details::initial_n;
+  using uri::punycode::decode_error_code;
+  using uri::punycode::details::adapt;
+  using uri::punycode::details::delimiter;
+  using uri::punycode::details::initial_bias;
+  using uri::punycode::details::initial_n;
 
   // Find the end of the literal portion (if there is one) by scanning for the
   // last delimiter.
   auto rb = std::find (input.rbegin (), input.rend (), delimiter);
   // NOLINTNEXTLINE(llvm-qualified-auto,readability-qualified-auto)
   auto b = rb == input.rend () ? input.begin () : rb.base () - 1;
-  std::copy (input.begin (), b, std::back_inserter (output));
+  auto const num_basics = static_cast<std::size_t> (b - input.begin ());
 
   // The main decoding loop.
   auto n = initial_n;
   auto i = std::string::size_type{0};
   auto bias = initial_bias;
+  auto length = num_basics;  // The current length of the output.
+  auto num_nonbasic = std::size_t{0};
   // Start just after the last delimiter if any basic code points were
   // copied; start at the beginning otherwise. *in is the next character to be
   // consumed.
@@ -116,30 +146,293 @@ decode_result decode (std::string_view const& input) {
     // to i. The overflow checking is easier if we increase i as we go, then
     // subtract off its starting value at the end to obtain delta.
     auto const decode_res = decode_vli (in, input.end (), i, bias);
-    static_assert (
-      std::is_same_v<std::error_code,
-                     std::remove_const_t<
-                       std::variant_alternative_t<0, decltype (decode_res)>>>);
     if (auto const* err = std::get_if<std::error_code> (&decode_res)) {
       return *err;
     }
     auto const old_vli = i;
     std::tie (i, in) = std::get<1> (decode_res);
-    bias = adapt (i - old_vli, output.length () + 1, old_vli == 0);
+    bias = adapt (i - old_vli, length + 1, old_vli == 0);
 
     // i was supposed to wrap around from out+1 to 0, incrementing n each time,
     // so we'll fix that now.
-    if (i / (output.length () + 1) > maxint - n) {
+    if (i / (length + 1) > maxint - n) {
       return make_error_code (decode_error_code::overflow);
     }
-    n += i / (output.length () + 1);
-    i %= (output.length () + 1);
+    n += i / (length + 1);
+    i %= (length + 1);
 
-    // Insert n into the output at position i.
-    output.insert (i, std::string::size_type{1}, static_cast<char32_t> (n));
+    // Record the insertion of n at position i.
+    scratch.code_points[num_nonbasic] = static_cast<char32_t> (n);
+    scratch.positions[num_nonbasic] = static_cast<std::uint32_t> (i);
+    ++num_nonbasic;
+    ++length;
     ++i;
   }
+
+  if (length > static_cast<std::size_t> (last - first)) {
+    return make_error_code (decode_error_code::too_long);
+  }
+  // Initially, every slot is free: each node of the tree counts the slots
+  // that it covers.
+  for (auto index = std::size_t{1}; index <= length; ++index) {
+    scratch.tree[index - 1U] =
+      static_cast<std::uint32_t> (index & (~index + 1U));
+    scratch.used[index - 1U] = false;
+  }
+  for (auto k = num_nonbasic; k > 0U; --k) {
+    auto const slot =
+      find_free_slot (scratch.tree, length, scratch.positions[k - 1U]);
+    first[slot] = scratch.code_points[k - 1U];
+    scratch.used[slot] = true;
+    for (auto index = slot + 1U; index <= length;
+         index += index & (~index + 1U)) {
+      --scratch.tree[index - 1U];
+    }
+  }
+  auto basic = input.begin ();
+  for (auto slot = std::size_t{0}; slot < length; ++slot) {
+    if (!scratch.used[slot]) {
+      first[slot] = static_cast<char32_t> (*(basic++));
+    }
+  }
+  assert (basic == b);
+  return first + length;
+}
+
+constexpr auto ace_prefix = std::string_view{"xn--"};
+
+/// Returns true if \p label starts with the ACE prefix "xn--". The prefix is
+/// case-insensitive.
+constexpr bool has_ace_prefix (std::string_view const label) noexcept {
+  return label.size () >= ace_prefix.size () &&
+         (static_cast<unsigned char> (label[0]) | 0x20U) == 'x' &&
+         (static_cast<unsigned char> (label[1]) | 0x20U) == 'n' &&
+         label[2] == '-' && label[3] == '-';
+}
+
+/// Calls \p f for each of the '.' separated labels of \p host. Stops at the
+/// first label for which \p f returns an error.
+template <typename Function>
+std::error_code for_each_label (std::string_view host, Function f) {
+  for (;;) {
+    auto const dot = host.find ('.');
+    if (auto const err = f (host.substr (0, dot))) {
+      return err;
+    }
+    if (dot == std::string_view::npos) {
+      return {};
+    }
+    host.remove_prefix (dot + 1U);
+  }
+}
+
+/// Returns true if any of the labels of \p host has the ACE prefix.
+constexpr bool has_ace_label (std::string_view host) noexcept {
+  for (;;) {
+    if (has_ace_prefix (host)) {
+      return true;
+    }
+    auto const dot = host.find ('.');
+    if (dot == std::string_view::npos) {
+      return false;
+    }
+    host.remove_prefix (dot + 1U);
+  }
+}
+
+/// Calls \p f with a buffer of at least \p size code points. No dynamically
+/// allocated storage is used for a DNS label.
+template <typename Function>
+auto with_code_point_buffer (std::size_t const size, Function f) {
+  static constexpr auto max_inline = std::size_t{256};
+  if (size <= max_inline) {
+    std::array<char32_t, max_inline> buffer;
+    return f (buffer.data ());
+  }
+  std::vector<char32_t> buffer (size);
+  return f (buffer.data ());
+}
+
+/// Checks that the label \p label (which has the ACE prefix) holds valid
+/// punycode.
+std::error_code check_ace_label (std::string_view label) {
+  label.remove_prefix (ace_prefix.size ());
+  return with_code_point_buffer (label.size (), [label] (char32_t* const cps) {
+    auto const r = uri::punycode::decode (label, cps, cps + label.size ());
+    auto const* const err = std::get_if<std::error_code> (&r);
+    return err != nullptr ? *err : std::error_code{};
+  });
+}
+
+}  // end anonymous namespace
+
+namespace uri::punycode {
+
+char const* error_category::name () const noexcept {
+  return "punycode decode";
+}
+std::string error_category::message (int error) const {
+  auto const* m = "unknown error";
+  switch (static_cast<decode_error_code> (error)) {
+  case decode_error_code::bad_input: m = "bad input"; break;
+  case decode_error_code::overflow: m = "overflow"; break;
+  case decode_error_code::too_long: m = "output too long"; break;
+  case decode_error_code::none: m = "unknown error"; break;
+  }
+  return m;
+}
+std::error_code make_error_code (decode_error_code const e) {
+  static error_category category;
+  return {static_cast<int> (e), category};
+}
+
+std::variant<std::error_code, char32_t*> decode (std::string_view const& input,
+                                                char32_t* const first,
+                                                char32_t* const last) {
+  // At most one code point is produced for each input character.
+  if (input.size () <= max_inline_label) {
+    std::array<char32_t, max_inline_label> code_points;
+    std::array<std::uint32_t, max_inline_label> positions;
+    std::array<std::uint32_t, max_inline_label> tree;
+    std::array<bool, max_inline_label> used;
+    return decode_into (
+      input,
+      decode_scratch{code_points.data (), positions.data (), tree.data (),
+                     used.data ()},
+      first, last);
+  }
+  std::vector<char32_t> code_points (input.size ());
+  std::vector<std::uint32_t> positions (input.size ());
+  std::vector<std::uint32_t> tree (input.size ());
+  auto used = std::make_unique<bool[]> (input.size ());
+  return decode_into (input,
+                      decode_scratch{code_points.data (), positions.data (),
+                                     tree.data (), used.get ()},
+                      first, last);
+}
+
+decode_result decode (std::string_view const& input) {
+  std::u32string output;
+  output.resize (input.size ());
+  auto const r =
+    decode (input, output.data (), output.data () + output.size ());
+  if (auto const* const err = std::get_if<std::error_code> (&r)) {
+    return *err;
+  }
+  output.resize (static_cast<std::size_t> (std::get<char32_t*> (r) -
+                                           output.data ()));
   return output;
 }
 
+std::error_code encode (std::string_view const& input, std::string& output) {
+  return with_code_point_buffer (
+    input.size (), [&input, &output] (char32_t* const cps) {
+      auto const* const end =
+        utf8::to_utf32 (input.data (), input.data () + input.size (), cps);
+      if (end == nullptr) {
+        return make_error_code (decode_error_code::bad_input);
+      }
+      encode (std::u32string_view{cps, static_cast<std::size_t> (end - cps)},
+              std::back_inserter (output));
+      return std::error_code{};
+    });
+}
+
+std::variant<std::error_code, char*> decode_utf8 (std::string_view const& input,
+                                                 char* const first,
+                                                 char* const last) {
+  return with_code_point_buffer (
+    input.size (),
+    [&input, first, last] (
+      char32_t* const cps) -> std::variant<std::error_code, char*> {
+      auto const r = decode (input, cps, cps + input.size ());
+      if (auto const* const err = std::get_if<std::error_code> (&r)) {
+        return *err;
+      }
+      auto const* const end = std::get<char32_t*> (r);
+      if (last - first < 4 * (end - cps)) {
+        return make_error_code (decode_error_code::too_long);
+      }
+      auto* const out = utf8::to_utf8 (cps, end, first);
+      if (out == nullptr) {
+        return make_error_code (decode_error_code::bad_input);
+      }
+      return out;
+    });
+}
+
+std::error_code decode (std::string_view const& input, std::string& output) {
+  auto const size = output.size ();
+  output.resize (size + 4U * input.size ());
+  auto const r = decode_utf8 (input, output.data () + size,
+                              output.data () + output.size ());
+  if (auto const* const err = std::get_if<std::error_code> (&r)) {
+    output.resize (size);
+    return *err;
+  }
+  output.resize (static_cast<std::size_t> (std::get<char*> (r) -
+                                           output.data ()));
+  return std::error_code{};
+}
+
+host_result to_ascii (std::string_view const host, std::string& buffer) {
+  auto const is_ascii = [] (std::string_view const str) {
+    auto const* const last = str.data () + str.size ();
+    return simd::find_non_ascii (str.data (), last) == last;
+  };
+  if (is_ascii (host)) {
+    // The common case: nothing needs to be encoded.
+    if (auto const err =
+          for_each_label (host, [] (std::string_view const label) {
+            return has_ace_prefix (label) ? check_ace_label (label)
+                                          : std::error_code{};
+          })) {
+      return err;
+    }
+    return host;
+  }
+
+  buffer.clear ();
+  buffer.reserve (host.size () + ace_prefix.size ());
+  auto const err = for_each_label (host, [&] (std::string_view const label) {
+    if (label.data () != host.data ()) {
+      buffer += '.';
+    }
+    if (is_ascii (label)) {
+      buffer += label;
+      return has_ace_prefix (label) ? check_ace_label (label)
+                                    : std::error_code{};
+    }
+    buffer += ace_prefix;
+    return encode (label, buffer);
+  });
+  if (err) {
+    return err;
+  }
+  return std::string_view{buffer};
+}
+
+host_result to_unicode (std::string_view const host, std::string& buffer) {
+  if (!has_ace_label (host)) {
+    // There are no ACE labels: nothing needs to be decoded.
+    return host;
+  }
+  buffer.clear ();
+  buffer.reserve (host.size () * 2U);
+  auto const err = for_each_label (host, [&] (std::string_view const label) {
+    if (label.data () != host.data ()) {
+      buffer += '.';
+    }
+    if (!has_ace_prefix (label)) {
+      buffer += label;
+      return std::error_code{};
+    }
+    return decode (label.substr (ace_prefix.size ()), buffer);
+  });
+  if (err) {
+    return err;
+  }
+  return std::string_view{buffer};
+}
+
 }  // end namespace uri::punycode
@@ -0,0 +1,313 @@
+//===- lib/uri/punycode_cache.cpp -----------------------------------------===//
+//*                                        _                        _          *
+//*  _ __  _   _ _ __  _   _  ___ ___   __| | ___     ___ __ _  ___| |__   ___ *
+//* | '_ \| | | | '_ \| | | |/ __/ _ \ / _` |/ _ \   / __/ _` |/ __| '_ \ / _ \*
+//* | |_) | |_| | | | | |_| | (_| (_) | (_| |  __/  | (_| (_| | (__| | | |  __/*
+//* | .__/ \__,_|_| |_|\__, |\___\___/ \__,_|\___|___\___\__,_|\___|_| |_|\___|*
+//* |_|                |___/                    |_____|                        *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/punycode_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+#include "uri/punycode.hpp"
+
+namespace uri::punycode {
+
+// shard
+// ~~~~~
+/// A shard holds a fixed number of entries in an arena of slots. A hash table
+/// (with chaining through the nodes) finds an entry from its key and a doubly
+/// linked list through the nodes records the order in which they were used.
+class cache::shard {
+public:
+  /// Allocates storage for \p slots entries.
+  void reset (std::size_t slots);
+
+  /// Looks for the entry for operation \p op and \p key. If found, its value
+  /// is appended to \p output and it becomes the most recently used entry.
+  bool find (operation op, std::size_t hash, std::string_view const& key,
+             std::string& output);
+  /// Adds an entry for operation \p op and \p key, evicting the least recently
+  /// used entry if the shard is full.
+  void insert (operation op, std::size_t hash, std::string_view const& key,
+               std::string_view const& value);
+  void clear ();
+  void add_to (cache_statistics& stats) const;
+
+private:
+  static constexpr auto none = std::numeric_limits<std::uint32_t>::max ();
+
+  struct node {
+    std::size_t hash = 0;
+    std::uint32_t chain = none;  ///< The next node in the same bucket.
+    std::uint32_t prev = none;   ///< The next more recently used node.
+    /// The next less recently used node or, for an unused node, the next
+    /// member of the free list.
+    std::uint32_t next = none;
+    operation op = operation::encode;
+    std::uint16_t key_size = 0;
+    std::uint16_t value_size = 0;
+  };
+  static_assert (cache::slot_size <=
+                 std::numeric_limits<std::uint16_t>::max ());
+
+  char* slot (std::uint32_t const index) noexcept {
+    return arena_.get () + std::size_t{index} * slot_size;
+  }
+  std::uint32_t& bucket (std::size_t const hash) noexcept {
+    return buckets_[hash & (buckets_.size () - 1U)];
+  }
+  std::uint32_t lookup (operation op, std::size_t hash,
+                        std::string_view const& key) noexcept;
+  void unlink (std::uint32_t index) noexcept;
+  void push_front (std::uint32_t index) noexcept;
+  void evict (std::uint32_t index) noexcept;
+
+  mutable std::mutex mutex_;
+  std::unique_ptr<char[]> arena_;
+  std::vector<node> nodes_;
+  std::vector<std::uint32_t> buckets_;
+  std::uint32_t mru_ = none;   ///< The most recently used node.
+  std::uint32_t lru_ = none;   ///< The least recently used node.
+  std::uint32_t free_ = none;  ///< The first unused node.
+  std::uint64_t hits_ = 0;
+  std::uint64_t misses_ = 0;
+  std::uint64_t evictions_ = 0;
+  std::size_t entries_ = 0;
+};
+
+// reset
+// ~~~~~
+void cache::shard::reset (std::size_t const slots) {
+  assert (slots > 0U && slots < none);
+  arena_ = std::make_unique<char[]> (slots * slot_size);
+  nodes_.resize (slots);
+  auto buckets = std::size_t{1};
+  while (buckets < slots) {
+    buckets <<= 1U;
+  }
+  buckets_.resize (buckets);
+  this->clear ();
+}
+
+// clear
+// ~~~~~
+void cache::shard::clear () {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  std::fill (std::begin (buckets_), std::end (buckets_), none);
+  // Thread all of the nodes onto the free list.
+  auto next = none;
+  for (auto index = nodes_.size (); index > 0U; --index) {
+    nodes_[index - 1U].next = next;
+    next = static_cast<std::uint32_t> (index - 1U);
+  }
+  free_ = next;
+  mru_ = none;
+  lru_ = none;
+  hits_ = 0;
+  misses_ = 0;
+  evictions_ = 0;
+  entries_ = 0;
+}
+
+// lookup
+// ~~~~~~
+std::uint32_t cache::shard::lookup (operation const op, std::size_t const hash,
+                                    std::string_view const& key) noexcept {
+  for (auto index = bucket (hash); index != none;
+       index = nodes_[index].chain) {
+    auto const& n = nodes_[index];
+    if (n.hash == hash && n.op == op && n.key_size == key.size () &&
+        std::memcmp (slot (index), key.data (), key.size ()) == 0) {
+      return index;
+    }
+  }
+  return none;
+}
+
+// unlink
+// ~~~~~~
+/// Removes node \p index from the most recently used list.
+void cache::shard::unlink (std::uint32_t const index) noexcept {
+  auto& n = nodes_[index];
+  (n.prev == none ? mru_ : nodes_[n.prev].next) = n.next;
+  (n.next == none ? lru_ : nodes_[n.next].prev) = n.prev;
+}
+
+// push front
+// ~~~~~~~~~~
+/// Makes node \p index the most recently used.
+void cache::shard::push_front (std::uint32_t const index) noexcept {
+  auto& n = nodes_[index];
+  n.prev = none;
+  n.next = mru_;
+  (mru_ == none ? lru_ : nodes_[mru_].prev) = index;
+  mru_ = index;
+}
+
+// evict
+// ~~~~~
+/// Removes node \p index from its hash chain and the most recently used list.
+void cache::shard::evict (std::uint32_t const index) noexcept {
+  this->unlink (index);
+  auto* link = &bucket (nodes_[index].hash);
+  while (*link != index) {
+    link = &nodes_[*link].chain;
+  }
+  *link = nodes_[index].chain;
+  ++evictions_;
+  --entries_;
+}
+
+// find
+// ~~~~
+bool cache::shard::find (operation const op, std::size_t const hash,
+                         std::string_view const& key, std::string& output) {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  auto const index = this->lookup (op, hash, key);
+  if (index == none) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  if (index != mru_) {
+    this->unlink (index);
+    this->push_front (index);
+  }
+  auto const& n = nodes_[index];
+  output.append (slot (index) + n.key_size, n.value_size);
+  return true;
+}
+
+// insert
+// ~~~~~~
+void cache::shard::insert (operation const op, std::size_t const hash,
+                           std::string_view const& key,
+                           std::string_view const& value) {
+  if (key.size () + value.size () > slot_size) {
+    return;
+  }
+  std::lock_guard<std::mutex> const lock{mutex_};
+  if (this->lookup (op, hash, key) != none) {
+    return;  // Another thread added this entry after we looked for it.
+  }
+  auto index = free_;
+  if (index != none) {
+    free_ = nodes_[index].next;
+  } else {
+    index = lru_;
+    this->evict (index);
+  }
+  auto& n = nodes_[index];
+  n.hash = hash;
+  n.op = op;
+  n.key_size = static_cast<std::uint16_t> (key.size ());
+  n.value_size = static_cast<std::uint16_t> (value.size ());
+  auto* const s = slot (index);
+  std::copy (std::begin (key), std::end (key), s);
+  std::copy (std::begin (value), std::end (value), s + key.size ());
+  auto& b = bucket (hash);
+  n.chain = b;
+  b = index;
+  this->push_front (index);
+  ++entries_;
+}
+
+// add to
+// ~~~~~~
+void cache::shard::add_to (cache_statistics& stats) const {
+  std::lock_guard<std::mutex> const lock{mutex_};
+  stats.hits += hits_;
+  stats.misses += misses_;
+  stats.evictions += evictions_;
+  stats.entries += entries_;
+}
+
+// cache
+// ~~~~~
+cache::cache (std::size_t const budget, unsigned const shards) {
+  // The approximate number of bytes used by each entry: its slot, node, and
+  // up to two buckets.
+  constexpr auto entry_size =
+    slot_size + sizeof (std::size_t) + 4U * sizeof (std::uint32_t) +
+    2U * sizeof (std::uint32_t);
+  // Each shard holds at least one entry so there can be no more shards than
+  // the budget has entries.
+  auto const limit = std::clamp (budget / entry_size, std::size_t{1},
+                                 std::size_t{max_shards});
+  auto num_shards = 1U;
+  while (num_shards < shards && num_shards * 2U <= limit) {
+    num_shards <<= 1U;
+  }
+  mask_ = num_shards - 1U;
+  shards_ = std::make_unique<shard[]> (num_shards);
+  auto const slots = std::clamp (budget / num_shards / entry_size,
+                                 std::size_t{1}, std::size_t{1} << 24U);
+  for (auto ctr = 0U; ctr < num_shards; ++ctr) {
+    shards_[ctr].reset (slots);
+  }
+}
+
+cache::~cache () noexcept = default;
+
+template <typename Function>
+std::error_code cache::lookup (operation const op,
+                               std::string_view const& input,
+                               std::string& output, Function compute) {
+  auto const hash = std::hash<std::string_view>{}(input);
+  // The low bits of the hash select a bucket within a shard so the shard is
+  // chosen using higher bits.
+  auto& s = shards_[(hash >> 24U) & mask_];
+  if (s.find (op, hash, input, output)) {
+    return {};
+  }
+  auto const size = output.size ();
+  if (auto const err = compute (input, output)) {
+    return err;
+  }
+  s.insert (op, hash, input, std::string_view{output}.substr (size));
+  return {};
+}
+
+std::error_code cache::encode (std::string_view const& input,
+                               std::string& output) {
+  return this->lookup (operation::encode, input, output,
+                       [] (std::string_view const& in, std::string& out) {
+                         return punycode::encode (in, out);
+                       });
+}
+
+std::error_code cache::decode (std::string_view const& input,
+                               std::string& output) {
+  return this->lookup (operation::decode, input, output,
+                       [] (std::string_view const& in, std::string& out) {
+                         return punycode::decode (in, out);
+                       });
+}
+
+cache_statistics cache::statistics () const {
+  cache_statistics result;
+  for (auto ctr = 0U; ctr <= mask_; ++ctr) {
+    shards_[ctr].add_to (result);
+  }
+  return result;
+}
+
+void cache::clear () {
+  for (auto ctr = 0U; ctr <= mask_; ++ctr) {
+    shards_[ctr].clear ();
+  }
+}
+
+}  // end namespace uri::punycode
@@ -0,0 +1,164 @@
+//===- lib/uri/query.cpp --------------------------------------------------===//
+//*                               *
+//*   __ _ _   _  ___ _ __ _   _  *
+//*  / _` | | | |/ _ \ '__| | | | *
+//* | (_| | |_| |  __/ |  | |_| | *
+//*  \__, |\__,_|\___|_|   \__, | *
+//*     |_|                |___/  *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/query.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+
+#include "uri/pctdecode.hpp"
+
+namespace uri {
+
+std::string_view form_decode (std::string_view const s, std::string& buffer) {
+  if (!needs_form_decode (s)) {
+    return s;
+  }
+  buffer.assign (s);
+  // Spaces must be restored before escapes are decoded so that "%2B" yields
+  // '+' rather than a space.
+  std::replace (buffer.begin (), buffer.end (), '+', ' ');
+  return pctdecode_inplace (buffer);
+}
+
+// query index
+// ~~~~~~~~~~~
+query_index::query_index (std::string_view const query) {
+  // A first pass counts the pairs and the space needed for decoded keys so
+  // that storage can be allocated (if at all) once.
+  auto decoded_size = std::size_t{0};
+  for (auto const& param : query_params{query}) {
+    ++size_;
+    if (needs_form_decode (param.key)) {
+      decoded_size += param.key.length ();
+    }
+  }
+  assert (size_ < no_entry);
+  auto slots_size = inline_slots_.size ();
+  entry* entries = inline_entries_.data ();
+  std::uint32_t* slots = inline_slots_.data ();
+  if (size_ > inline_params) {
+    heap_entries_.resize (size_);
+    entries = heap_entries_.data ();
+    // Keep the load factor at or below one half.
+    while (slots_size < size_ * 2) {
+      slots_size *= 2;
+    }
+    heap_slots_.resize (slots_size);
+    slots = heap_slots_.data ();
+  }
+  mask_ = slots_size - 1U;
+  std::fill_n (slots, slots_size, no_entry);
+  decoded_keys_.reserve (decoded_size);
+
+  std::string buffer;
+  auto index = std::uint32_t{0};
+  for (auto const& param : query_params{query}) {
+    auto key = form_decode (param.key, buffer);
+    if (needs_form_decode (param.key)) {
+      // The key was decoded: move it to storage owned by the index. The space
+      // was reserved in advance so the vector's contents won't move.
+      auto const offset = decoded_keys_.size ();
+      decoded_keys_.insert (decoded_keys_.end (), key.begin (), key.end ());
+      key = std::string_view{decoded_keys_.data () + offset, key.length ()};
+    }
+    entries[index] = entry{param, key, no_entry, index};
+
+    // Insert into the hash table using linear probing. If the key is already
+    // present, the new entry is added to the end of its chain.
+    for (auto slot = std::hash<std::string_view>{}(key) & mask_;;
+         slot = (slot + 1U) & mask_) {
+      auto& s = slots[slot];
+      if (s == no_entry) {
+        s = index;
+        break;
+      }
+      if (auto& h = entries[s]; h.key == key) {
+        entries[h.tail].next = index;
+        h.tail = index;
+        break;
+      }
+    }
+    ++index;
+  }
+}
+
+query_index::query_index (query_index&& other) noexcept
+    : size_{other.size_},
+      mask_{other.mask_},
+      inline_entries_{other.inline_entries_},
+      inline_slots_{other.inline_slots_},
+      heap_entries_{std::move (other.heap_entries_)},
+      heap_slots_{std::move (other.heap_slots_)},
+      decoded_keys_{std::move (other.decoded_keys_)} {
+  other.reset ();
+}
+
+auto query_index::operator= (query_index&& other) noexcept -> query_index& {
+  if (&other != this) {
+    size_ = other.size_;
+    mask_ = other.mask_;
+    inline_entries_ = other.inline_entries_;
+    inline_slots_ = other.inline_slots_;
+    heap_entries_ = std::move (other.heap_entries_);
+    heap_slots_ = std::move (other.heap_slots_);
+    decoded_keys_ = std::move (other.decoded_keys_);
+    other.reset ();
+  }
+  return *this;
+}
+
+void query_index::reset () noexcept {
+  // The moved-from vectors are valid but unspecified: make sure that they are
+  // empty so that entries() and slots() select the inline storage.
+  heap_entries_.clear ();
+  heap_slots_.clear ();
+  decoded_keys_.clear ();
+  size_ = 0;
+  mask_ = inline_slots_.size () - 1U;
+  inline_slots_.fill (no_entry);
+}
+
+std::uint32_t query_index::head (std::string_view const key) const noexcept {
+  auto const* const e = this->entries ();
+  auto const* const slots = this->slots ();
+  for (auto slot = std::hash<std::string_view>{}(key) & mask_;;
+       slot = (slot + 1U) & mask_) {
+    auto const s = slots[slot];
+    if (s == no_entry || e[s].key == key) {
+      return s;
+    }
+  }
+}
+
+std::optional<std::string_view> query_index::find (
+  std::string_view const key) const noexcept {
+  if (auto const h = this->head (key); h != no_entry) {
+    return this->entries ()[h].param.value;
+  }
+  return std::nullopt;
+}
+
+auto query_index::values (std::string_view const key) const noexcept
+  -> value_range {
+  auto const* const e = this->entries ();
+  return {value_iterator{e, this->head (key)}, value_iterator{e, no_entry}};
+}
+
+std::size_t query_index::count (std::string_view const key) const noexcept {
+  auto const r = this->values (key);
+  return static_cast<std::size_t> (std::distance (r.begin (), r.end ()));
+}
+
+}  // end namespace uri
@@ -12,13 +12,16 @@
 //===----------------------------------------------------------------------===//
 #include "uri/rule.hpp"
 
-#include <iomanip>
-#include <iostream>
+#include "uri/trace.hpp"
 
 namespace uri {
 
 bool rule::done () const {
-  if (!tail_ || !tail_->empty ()) {
+  if (!tail_) {
+    return false;
+  }
+  if (!tail_->empty ()) {
+    failed_at (tail_->data ());  // Unmatched input remains.
     return false;
   }
   // Run all of the acceptor functions that were gathered on the grammar path
@@ -32,22 +35,23 @@ bool rule::done () const {
 
 rule::matched_result rule::matched (char const* name, rule const& in) const {
   assert (!tail_ || in.tail_);
-  static constexpr auto trace = false;
-  if constexpr (trace) {
-    std::cout << (tail_ ? '*' : '-') << ' ' << std::quoted (name);
-  }
-
   if (tail_) {
     std::string_view const str =
       in.tail_->substr (0, in.tail_->length () - tail_->length ());
-    if constexpr (trace) {
-      std::cout << ' ' << std::quoted (str) << '\n';
+#if URI_TRACE
+    if (trace::enabled ()) {
+      trace::details::record (name, true, str.length ());
     }
+#endif
     return std::make_tuple (str, acceptors_);
   }
-
-  if constexpr (trace) {
-    std::cout << '\n';
+#if URI_TRACE
+  if (trace::enabled ()) {
+    trace::details::record (name, false, 0U);
+  }
+#endif
+  if (in.failure_ != nullptr && in.tail_) {
+    in.failure_->fail (name, in.tail_->data ());
   }
   return {};
 }
@@ -0,0 +1,177 @@
+//===- lib/uri/simd.hpp -----------------------------------*- mode: C++ -*-===//
+//*      _               _  *
+//*  ___(_)_ __ ___   __| | *
+//* / __| | '_ ` _ \ / _` | *
+//* \__ \ | | | | | | (_| | *
+//* |___/_|_| |_| |_|\__,_| *
+//*                         *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file simd.hpp
+/// \brief Helpers for the library's vectorized string kernels.
+///
+/// SSE2 is used where it is available (it is part of the x86-64 baseline so
+/// no additional compiler flags are needed). Elsewhere each helper falls back
+/// to a portable scalar implementation.
+#ifndef URI_SIMD_HPP
+#define URI_SIMD_HPP
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define URI_SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define URI_SIMD_SSE2 0
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace uri::simd {
+
+/// Returns the number of trailing zero bits in \p v which must not be zero.
+inline unsigned countr_zero (std::uint32_t const v) noexcept {
+  assert (v != 0U);
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long index = 0;
+  _BitScanForward (&index, v);
+  return static_cast<unsigned> (index);
+#else
+  return static_cast<unsigned> (__builtin_ctz (v));
+#endif
+}
+
+/// Returns the number of bits set in \p v.
+inline unsigned popcount (std::uint32_t v) noexcept {
+#if defined(_MSC_VER) && !defined(__clang__)
+  // __popcnt() requires the POPCNT instruction so use the portable version.
+  v = v - ((v >> 1U) & 0x55555555U);
+  v = (v & 0x33333333U) + ((v >> 2U) & 0x33333333U);
+  v = (v + (v >> 4U)) & 0x0F0F0F0FU;
+  return static_cast<unsigned> ((v * 0x01010101U) >> 24U);
+#else
+  return static_cast<unsigned> (__builtin_popcount (v));
+#endif
+}
+
+#if URI_SIMD_SSE2
+constexpr auto block_size = std::size_t{16};
+
+/// Loads a (possibly unaligned) block of bytes starting at \p p.
+inline __m128i load (void const* const p) noexcept {
+  __m128i block;
+  std::memcpy (&block, p, sizeof (block));
+  return block;
+}
+
+/// Stores \p block to the (possibly unaligned) address \p p.
+inline void store (void* const p, __m128i const block) noexcept {
+  std::memcpy (p, &block, sizeof (block));
+}
+
+/// Returns a mask with bit n set if byte n of \p block is equal to \p c.
+inline std::uint32_t equal_mask (__m128i const block, char const c) noexcept {
+  return static_cast<std::uint32_t> (
+    _mm_movemask_epi8 (_mm_cmpeq_epi8 (block, _mm_set1_epi8 (c))));
+}
+
+// SSSE3 is not part of the x86-64 baseline. Functions which use it are compiled
+// for that target and are only called if has_ssse3() returns true.
+#if defined(__GNUC__) || defined(__clang__)
+#define URI_SIMD_TARGET_SSSE3 __attribute__ ((target ("ssse3")))
+#else
+#define URI_SIMD_TARGET_SSSE3
+#endif
+
+/// Returns true if the host processor supports the SSSE3 instructions.
+inline bool has_ssse3 () noexcept {
+#if defined(__SSSE3__)
+  return true;
+#elif defined(__GNUC__) || defined(__clang__)
+  static bool const result = __builtin_cpu_supports ("ssse3") != 0;
+  return result;
+#else
+  static bool const result = [] {
+    std::array<int, 4> info{};
+    __cpuid (info.data (), 1);
+    return (static_cast<unsigned> (info[2]) & (1U << 9U)) != 0U;
+  }();
+  return result;
+#endif
+}
+#endif  // URI_SIMD_SSE2
+
+/// Returns a pointer to the first instance of \p c in the range [first, last)
+/// or \p last if there is none.
+inline char const* find (char const* first, char const* const last,
+                         char const c) noexcept {
+#if URI_SIMD_SSE2
+  for (; static_cast<std::size_t> (last - first) >= block_size;
+       first += block_size) {
+    if (auto const mask = equal_mask (load (first), c); mask != 0U) {
+      return first + countr_zero (mask);
+    }
+  }
+#endif  // URI_SIMD_SSE2
+  auto const* const pos = std::char_traits<char>::find (
+    first, static_cast<std::size_t> (last - first), c);
+  return pos == nullptr ? last : pos;
+}
+
+/// Returns a pointer to the first instance of either \p c1 or \p c2 in the
+/// range [first, last) or \p last if there is none.
+inline char const* find (char const* first, char const* const last,
+                         char const c1, char const c2) noexcept {
+#if URI_SIMD_SSE2
+  for (; static_cast<std::size_t> (last - first) >= block_size;
+       first += block_size) {
+    auto const block = load (first);
+    if (auto const mask = equal_mask (block, c1) | equal_mask (block, c2);
+        mask != 0U) {
+      return first + countr_zero (mask);
+    }
+  }
+#endif  // URI_SIMD_SSE2
+  for (; first != last; ++first) {
+    if (*first == c1 || *first == c2) {
+      break;
+    }
+  }
+  return first;
+}
+
+/// Returns a pointer to the first byte in the range [first, last) which is not
+/// ASCII (that is, has its top bit set) or \p last if there is none.
+inline char const* find_non_ascii (char const* first,
+                                   char const* const last) noexcept {
+#if URI_SIMD_SSE2
+  for (; static_cast<std::size_t> (last - first) >= block_size;
+       first += block_size) {
+    if (auto const mask = static_cast<std::uint32_t> (
+          _mm_movemask_epi8 (load (first)));
+        mask != 0U) {
+      return first + countr_zero (mask);
+    }
+  }
+#endif  // URI_SIMD_SSE2
+  for (; first != last; ++first) {
+    if ((static_cast<unsigned char> (*first) & 0x80U) != 0U) {
+      break;
+    }
+  }
+  return first;
+}
+
+}  // end namespace uri::simd
+
+#endif  // URI_SIMD_HPP
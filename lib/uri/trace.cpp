@@ -0,0 +1,147 @@
+//===- lib/uri/trace.cpp --------------------------------------------------===//
+//*  _                       *
+//* | |_ _ __ __ _  ___ ___  *
+//* | __| '__/ _` |/ __/ _ \ *
+//* | |_| | | (_| | (_|  __/ *
+//*  \__|_|  \__,_|\___\___| *
+//*                          *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/trace.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+
+namespace {
+
+class registry {
+public:
+  void record (char const* const name, bool const success,
+               std::size_t const bytes) {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    auto& c = counts_[name];
+    ++c.attempts;
+    if (success) {
+      ++c.successes;
+      c.bytes += bytes;
+    } else {
+      ++c.failures;
+    }
+  }
+  void reset () {
+    std::lock_guard<std::mutex> const lock{mutex_};
+    counts_.clear ();
+  }
+  std::vector<std::pair<std::string, uri::trace::counters>> snapshot () const {
+    std::vector<std::pair<std::string, uri::trace::counters>> result;
+    {
+      std::lock_guard<std::mutex> const lock{mutex_};
+      result.reserve (counts_.size ());
+      for (auto const& [name, c] : counts_) {
+        result.emplace_back (name, c);
+      }
+    }
+    std::sort (std::begin (result), std::end (result),
+               [] (auto const& a, auto const& b) {
+                 return a.second.attempts != b.second.attempts
+                          ? a.second.attempts > b.second.attempts
+                          : a.first < b.first;
+               });
+    return result;
+  }
+
+private:
+  mutable std::mutex mutex_;
+  // The names are string literals so that a view of each can be the key.
+  std::unordered_map<std::string_view, uri::trace::counters> counts_;
+};
+
+registry& get_registry () {
+  static registry r;
+  return r;
+}
+
+/// Writes \p str to \p os as a JSON string.
+std::ostream& write_json_string (std::ostream& os, std::string_view const str) {
+  os << '"';
+  for (auto const c : str) {
+    switch (c) {
+    case '"': os << "\\\""; break;
+    case '\\': os << "\\\\"; break;
+    case '\n': os << "\\n"; break;
+    case '\t': os << "\\t"; break;
+    default:
+      if (static_cast<unsigned char> (c) < 0x20U) {
+        os << "\\u" << std::hex << std::setw (4) << std::setfill ('0')
+           << static_cast<unsigned> (c) << std::dec << std::setfill (' ');
+      } else {
+        os << c;
+      }
+      break;
+    }
+  }
+  return os << '"';
+}
+
+}  // end anonymous namespace
+
+namespace uri::trace {
+
+namespace details {
+
+void record (char const* const name, bool const success,
+             std::size_t const bytes) {
+  get_registry ().record (name, success, bytes);
+}
+
+}  // end namespace details
+
+void reset () {
+  get_registry ().reset ();
+}
+
+std::vector<std::pair<std::string, counters>> snapshot () {
+  return get_registry ().snapshot ();
+}
+
+std::ostream& write_table (std::ostream& os) {
+  auto const rows = snapshot ();
+  auto width = std::string::size_type{10};
+  for (auto const& row : rows) {
+    width = std::max (width, row.first.size ());
+  }
+  auto const w = static_cast<int> (width) + 2;
+  os << std::left << std::setw (w) << "production" << std::right
+     << std::setw (12) << "attempts" << std::setw (12) << "successes"
+     << std::setw (12) << "failures" << std::setw (12) << "bytes" << '\n';
+  for (auto const& [name, c] : rows) {
+    os << std::left << std::setw (w) << name << std::right << std::setw (12)
+       << c.attempts << std::setw (12) << c.successes << std::setw (12)
+       << c.failures << std::setw (12) << c.bytes << '\n';
+  }
+  return os;
+}
+
+std::ostream& write_json (std::ostream& os) {
+  os << '[';
+  auto separator = "";
+  for (auto const& [name, c] : snapshot ()) {
+    os << separator << "\n  {\"production\": ";
+    write_json_string (os, name);
+    os << ", \"attempts\": " << c.attempts
+       << ", \"successes\": " << c.successes
+       << ", \"failures\": " << c.failures << ", \"bytes\": " << c.bytes
+       << '}';
+    separator = ",";
+  }
+  return os << "\n]\n";
+}
+
+}  // end namespace uri::trace
@@ -11,11 +11,17 @@
 // SPDX-License-Identifier: MIT
 //===----------------------------------------------------------------------===//
 #include "uri/uri.hpp"
+#include "uri/grammar.hpp"
 #include "uri/rule.hpp"
 
+#include "char_classes.hpp"
+#include "host.hpp"
+
+#include <numeric>
 #include <sstream>
 
 using namespace uri;
+using namespace std::string_view_literals;
 
 namespace {
 
@@ -33,68 +39,66 @@ auto single_colon (rule const& r) {
     .matched ("single-colon", r);
 }
 
+namespace g = uri::grammar;
+
+// The character-level productions are compile-time grammars. Each of the
+// productions that is named in RFC 3986 is then wrapped for use as a rule.
+// The leaf productions and the bodies of repetitions are named so that they
+// are visible to tracing and diagnostics.
+
 // sub-delims    = "!" / "$" / "&" / "'" / "(" / ")"
 //               / "*" / "+" / "," / ";" / "="
-auto sub_delims (rule const& r) {
-  return r.single_char ([] (char const c) {
-    return c == '!' || c == '$' || c == '&' || c == '\'' || c == '(' ||
-           c == ')' || c == '*' || c == '+' || c == ',' || c == ';' || c == '=';
-  });
-}
+constexpr char sub_delims_name[] = "sub-delims";
+using sub_delims = g::named<
+  sub_delims_name,
+  g::one<'!', '$', '&', '\'', '(', ')', '*', '+', ',', ';', '='>>;
 
 // unreserved    = ALPHA / DIGIT / "-" / "." / "_" / "~"
-auto unreserved (rule const& r) {
-  return r.single_char ([] (char const c) {
-    return static_cast<bool> (std::isalnum (static_cast<int> (c))) ||
-           c == '-' || c == '.' || c == '_' || c == '~';
-  });
-}
+constexpr char unreserved_name[] = "unreserved";
+using unreserved =
+  g::named<unreserved_name,
+           g::alt<g::alpha, g::digit, g::one<'-', '.', '_', '~'>>>;
 
 // pct-encoded   = "%" HEXDIG HEXDIG
-auto pct_encoded (rule const& r) {
-  return r.concat (single_char ('%'))
-    .concat (hexdig)
-    .concat (hexdig)
-    .matched ("pct-encoded", r);
-}
+constexpr char pct_encoded_name[] = "pct-encoded";
+using pct_encoded =
+  g::named<pct_encoded_name, g::seq<g::ch<'%'>, g::hexdig, g::hexdig>>;
 
 // pchar         = unreserved / pct-encoded / sub-delims / ":" / "@"
-auto pchar (rule const& r) {
-  return r
-    .alternative (unreserved, pct_encoded, sub_delims, colon, commercial_at)
-    .matched ("pchar", r);
-}
+constexpr char pchar_name[] = "pchar";
+using pchar =
+  g::named<pchar_name,
+           g::alt<unreserved, pct_encoded, sub_delims, g::one<':', '@'>>>;
 
 // userinfo      = *( unreserved / pct-encoded / sub-delims / ":" )
+constexpr char userinfo_star_name[] = "userinfo/*";
 auto userinfo (rule const& r) {
-  return r
-    .star ([] (rule const& r2) {
-      return r2.alternative (unreserved, pct_encoded, sub_delims, colon)
-        .matched ("userinfo/*", r2);
-    })
-    .matched ("userinfo", r);
+  using production =
+    g::star<g::named<userinfo_star_name,
+                     g::alt<unreserved, pct_encoded, sub_delims, g::ch<':'>>>>;
+  return r.concat (g::as_rule<production>).matched ("userinfo", r);
 }
 constexpr auto userinfofn = userinfo;
 
 // scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+constexpr char scheme_star_name[] = "scheme/*";
 auto scheme (rule const& r) {
-  return r.concat (alpha)
-    .star ([] (rule const& r2) {
-      return r2.alternative (alpha, digit, plus, minus, full_stop)
-        .matched ("scheme/*", r2);
-    })
-    .matched ("scheme", r);
+  using production =
+    g::seq<g::alpha,
+           g::star<g::named<scheme_star_name,
+                            g::alt<g::alpha, g::digit,
+                                   g::one<'+', '-', '.'>>>>>;
+  return r.concat (g::as_rule<production>).matched ("scheme", r);
 }
 constexpr auto schemefn = scheme;
 
 // reg-name      = *( unreserved / pct-encoded / sub-delims )
+constexpr char reg_name_star_name[] = "reg-name/*";
 auto reg_name (rule const& r) {
-  return r
-    .star ([] (rule const& r1) {
-      return r1.alternative (unreserved, pct_encoded, sub_delims)
-        .matched ("reg-name/*", r1);
-    })
-    .matched ("reg-name", r);
+  using production =
+    g::star<g::named<reg_name_star_name,
+                     g::alt<unreserved, pct_encoded, sub_delims>>>;
+  return r.concat (g::as_rule<production>).matched ("reg-name", r);
 }
 
 // dec-octet     = DIGIT                 ; 0-9
@@ -285,17 +289,13 @@ auto ipv6address (rule const& r) {
 }
 
 // IPvFuture     = "v" 1*HEXDIG "." 1*( unreserved / sub-delims / ":" )
+constexpr char ipvfuture_plus_name[] = "unreserved / sub-delims / colon";
 auto ipvfuture (rule const& r) {
-  return r.concat (single_char ('v'))
-    .star (hexdig, 1)
-    .concat (full_stop)
-    .star (
-      [] (rule const& r1) {
-        return r1.alternative (unreserved, sub_delims, colon)
-          .matched ("unreserved / sub-delims / colon", r1);
-      },
-      1)
-    .matched ("IPvFuture", r);
+  using production =
+    g::seq<g::one<'v', 'V'>, g::plus<g::hexdig>, g::ch<'.'>,
+           g::plus<g::named<ipvfuture_plus_name,
+                            g::alt<unreserved, sub_delims, g::ch<':'>>>>>;
+  return r.concat (g::as_rule<production>).matched ("IPvFuture", r);
 }
 
 // IP-literal    = "[" ( IPv6address / IPvFuture ) "]"
@@ -316,10 +316,58 @@ auto host (rule const& r) {
 }
 constexpr auto hostfn = host;
 
-auto host_rule (uri::parts& result) {
-  return [&result] (rule const& r) {
+// split options
+// ~~~~~~~~~~~~~
+/// Wraps the match function \p match so that it fails if it matches more than
+/// \p max characters. The match only sees the first max + lookahead characters
+/// of the input so the cost of rejecting an over-long component is bounded by
+/// the limit rather than by the length of the input.
+template <typename MatchFunction>
+auto at_most (MatchFunction const match, std::size_t const max) {
+  return [match, max] (rule const& r) -> rule::matched_result {
+    // No element of the host or query grammars is longer than four characters
+    // (h16) so none decides its match by looking further ahead than that. A
+    // match of up to max characters is therefore unaffected by the shortened
+    // input whereas a longer match still exceeds max.
+    constexpr auto lookahead = std::size_t{4};
+    rule::matched_result m =
+      max < split_options::unlimited - lookahead && r.tail () &&
+          r.tail ()->length () > max + lookahead
+        ? match (r.prefix (max + lookahead))
+        : match (r);
+    if (m && std::get<std::string_view> (*m).length () > max) {
+      return {};
+    }
+    return m;
+  };
+}
+
+/// Matches the empty string if a path may have any segments at all. It
+/// precedes the productions whose first segment is not matched by star().
+auto segments_allowed (split_options const& options) {
+  return [&options] (rule const& r) -> rule::matched_result {
+    if (options.max_segments == 0U) {
+      return {};
+    }
+    return std::make_tuple (r.tail ()->substr (0, 0),
+                            rule::acceptor_container{});
+  };
+}
+
+/// The maximum number of repetitions of `"/" segment` in a path which
+/// already has \p first segments.
+unsigned repeated_segments (split_options const& options,
+                            std::size_t const first) {
+  auto const max =
+    options.max_segments - std::min (options.max_segments, first);
+  return static_cast<unsigned> (std::min (
+    max, static_cast<std::size_t> (std::numeric_limits<unsigned>::max ())));
+}
+
+auto host_rule (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r
-      .concat (hostfn,
+      .concat (at_most (hostfn, options.max_host_length),
                [&result] (std::string_view host) {
                  result.ensure_authority ().host = host;
                })
@@ -342,7 +390,7 @@ auto userinfo_at (uri::parts& result) {
 
 // port = *DIGIT
 auto port (rule const& r) {
-  return r.star (digit).matched ("port", r);
+  return r.concat (g::as_rule<g::star<g::digit>>).matched ("port", r);
 }
 constexpr auto portfn = port;
 
@@ -358,11 +406,11 @@ auto colon_port (uri::parts& result) {
   };
 }
 
-auto authority (uri::parts& result) {
+auto authority (uri::parts& result, split_options const& options) {
   // authority = [ userinfo "@" ] host [ ":" port ]
-  return [&result] (rule const& r) {
+  return [&result, &options] (rule const& r) {
     return r.optional (userinfo_at (result))
-      .concat (host_rule (result))
+      .concat (host_rule (result, options))
       .optional (colon_port (result))
       .matched ("authority", r);
   };
@@ -370,26 +418,23 @@ auto authority (uri::parts& result) {
 
 // segment       = *pchar
 auto segment (rule const& r) {
-  return r.star (pchar).matched ("segment", r);
+  return r.concat (g::as_rule<g::star<pchar>>).matched ("segment", r);
 }
 
 // segment-nz    = 1*pchar
 auto segment_nz (rule const& r) {
-  return r.star (pchar, 1U).matched ("segment-nz", r);
+  return r.concat (g::as_rule<g::plus<pchar>>).matched ("segment-nz", r);
 }
 
 // segment-nz-nc = 1*( unreserved / pct-encoded / sub-delims / "@" )
 //                  ; non-zero-length segment without any colon ":"
+constexpr char segment_nz_nc_plus_name[] =
+  "unreserved / pct-encoded / sub-delims / \"@\"";
 auto segment_nz_nc (rule const& r) {
-  return r
-    .star (
-      [] (rule const& r2) {
-        return r2
-          .alternative (unreserved, pct_encoded, sub_delims, commercial_at)
-          .matched ("unreserved / pct-encoded / sub-delims / \"@\"", r2);
-      },
-      1U)
-    .matched ("segment-nz-nc", r);
+  using production =
+    g::plus<g::named<segment_nz_nc_plus_name,
+                     g::alt<unreserved, pct_encoded, sub_delims, g::ch<'@'>>>>;
+  return r.concat (g::as_rule<production>).matched ("segment-nz-nc", r);
 }
 
 template <bool IsAbs>
@@ -434,30 +479,35 @@ private:
   uri::parts& result_;
 };
 
-auto path_abempty (uri::parts& result) {
+auto path_abempty (uri::parts& result, split_options const& options) {
   // path-abempty  = *( "/" segment )
-  return [&result] (rule const& r) {
+  return [&result, &options] (rule const& r) {
     return r
-      .star ([&result] (rule const& r2) {
-        return r2.concat (solidus, append_dir<true>{result})
-          .concat (segment, append_segment{result})
-          .matched ("\"/\" segment", r2);
-      })
+      .star (
+        [&result] (rule const& r2) {
+          return r2.concat (solidus, append_dir<true>{result})
+            .concat (segment, append_segment{result})
+            .matched ("\"/\" segment", r2);
+        },
+        0U, repeated_segments (options, 0U))
       .matched ("path-abempty", r);
   };
 }
 
-auto path_absolute (uri::parts& result) {
+auto path_absolute (uri::parts& result, split_options const& options) {
   // path-absolute = "/" [ segment-nz *( "/" segment ) ]
-  return [&result] (rule const& r) {
-    return r.concat (solidus, append_dir<true>{result})
-      .optional ([&result] (rule const& r1) {
+  return [&result, &options] (rule const& r) {
+    return r.concat (segments_allowed (options))
+      .concat (solidus, append_dir<true>{result})
+      .optional ([&result, &options] (rule const& r1) {
         return r1.concat (segment_nz, append_segment{result})
-          .star ([&result] (rule const& r2) {
-            return r2.concat (solidus, append_dir<false>{result})
-              .concat (segment, append_segment{result})
-              .matched ("\"/\" segment", r2);
-          })
+          .star (
+            [&result] (rule const& r2) {
+              return r2.concat (solidus, append_dir<false>{result})
+                .concat (segment, append_segment{result})
+                .matched ("\"/\" segment", r2);
+            },
+            0U, repeated_segments (options, 1U))
           .matched ("*( \"/\" segment )", r1);
       })
       .matched ("path-absolute", r);
@@ -465,43 +515,49 @@ auto path_absolute (uri::parts& result) {
 }
 
 // path-noscheme = segment-nz-nc *( "/" segment )
-auto path_noscheme (uri::parts& result) {
-  return [&result] (rule const& r) {
-    return r.concat (segment_nz_nc, record_initial_segment{result})
-      .star ([&result] (rule const& r1) {
-        return r1.concat (solidus, append_dir<false>{result})
-          .concat (segment, append_segment{result})
-          .matched ("\"/\" segment", r1);
-      })
+auto path_noscheme (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
+    return r.concat (segments_allowed (options))
+      .concat (segment_nz_nc, record_initial_segment{result})
+      .star (
+        [&result] (rule const& r1) {
+          return r1.concat (solidus, append_dir<false>{result})
+            .concat (segment, append_segment{result})
+            .matched ("\"/\" segment", r1);
+        },
+        0U, repeated_segments (options, 1U))
       .matched ("path-noscheme", r);
   };
 }
 
 // path-empty    = 0<pchar>
 auto path_empty (rule const& r) {
-  return r.star (pchar, 0, 0).matched ("path-empty", r);
+  return r.concat (g::as_rule<g::rep<0, 0, pchar>>).matched ("path-empty", r);
 }
 
 // path-rootless = segment-nz *( "/" segment )
-auto path_rootless (uri::parts& result) {
-  return [&result] (rule const& r) {
-    return r.concat (segment_nz, record_initial_segment{result})
-      .star ([&result] (rule const& r1) {
-        return r1.concat (solidus, append_dir<false>{result})
-          .concat (segment, append_segment{result})
-          .matched ("\"/\" segment", r1);
-      })
+auto path_rootless (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
+    return r.concat (segments_allowed (options))
+      .concat (segment_nz, record_initial_segment{result})
+      .star (
+        [&result] (rule const& r1) {
+          return r1.concat (solidus, append_dir<false>{result})
+            .concat (segment, append_segment{result})
+            .matched ("\"/\" segment", r1);
+        },
+        0U, repeated_segments (options, 1U))
       .matched ("path-rootless", r);
   };
 }
 
 // auth-abempty = "//" authority path-abempty
-auto auth_abempty (uri::parts& result) {
-  return [&result] (rule const& r) {
+auto auth_abempty (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r.concat (solidus)
       .concat (solidus)
-      .concat (authority (result))
-      .concat (path_abempty (result))
+      .concat (authority (result, options))
+      .concat (path_abempty (result, options))
       .matched ("auth-abempty", r);
   };
 }
@@ -510,33 +566,34 @@ auto auth_abempty (uri::parts& result) {
 //               / path-absolute
 //               / path-noscheme
 //               / path-empty
-auto relative_part (uri::parts& result) {
-  return [&result] (rule const& r) {
+auto relative_part (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r
-      .alternative (auth_abempty (result), path_absolute (result),
-                    path_noscheme (result), path_empty)
+      .alternative (auth_abempty (result, options),
+                    path_absolute (result, options),
+                    path_noscheme (result, options), path_empty)
       .matched ("relative-part", r);
   };
 }
 
 // query         = *( pchar / "/" / "?" )
+constexpr char query_star_name[] = R"(pchar / "/" / "?")";
 auto query (rule const& r) {
-  return r
-    .star ([] (rule const& r2) {
-      return r2.alternative (pchar, solidus, question_mark)
-        .matched (R"(pchar / "/" / "?")", r2);
-    })
-    .matched ("query", r);
+  using production =
+    g::star<g::named<query_star_name, g::alt<pchar, g::one<'/', '?'>>>>;
+  return r.concat (g::as_rule<production>).matched ("query", r);
 }
 constexpr auto queryfn = query;
 
 // question-query = "?" query
-auto question_query (uri::parts& result) {
-  return [&result] (rule const& r) {
+auto question_query (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r
       .concat (question_mark)  // "?"
-      .concat (query, [&result] (
-                        std::string_view const query) { result.query = query; })
+      .concat (at_most (queryfn, options.max_query_length),
+               [&result] (std::string_view const query) {
+                 result.query = query;
+               })
       .matched ("question-query", r);
   };
 }
@@ -560,10 +617,10 @@ auto hash_fragment (uri::parts& result) {
 };
 
 // relative-ref  = relative-part [ question-query ] [ hash-fragment ]
-auto relative_ref (uri::parts& result) {
-  return [&result] (rule const& r) {
-    return r.concat (relative_part (result))
-      .optional (question_query (result))
+auto relative_ref (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
+    return r.concat (relative_part (result, options))
+      .optional (question_query (result, options))
       .optional ([&result] (rule const& rf) {
         // "#" fragment
         return rf
@@ -588,53 +645,128 @@ auto relative_ref (uri::parts& result) {
 //               / path-absolute
 //               / path-rootless
 //               / path-empty
-auto hier_part (uri::parts& result) {
-  return [&result] (rule const& r) {
+auto hier_part (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r
-      .alternative (auth_abempty (result), path_absolute (result),
-                    path_rootless (result), path_empty)
+      .alternative (auth_abempty (result, options),
+                    path_absolute (result, options),
+                    path_rootless (result, options), path_empty)
       .matched ("hier-part", r);
   };
 }
 
 // URI = scheme ":" hier-part [ "?" query ] [ "#" fragment ]
-auto URI (uri::parts& result) {
-  return [&result] (rule const& r) {
+auto URI (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r
       .concat (
         scheme,
         [&result] (std::string_view const scheme) { result.scheme = scheme; })
       .concat (colon)
-      .concat (hier_part (result))
-      .optional (question_query (result))
+      .concat (hier_part (result, options))
+      .optional (question_query (result, options))
       .optional (hash_fragment (result))
       .matched ("URI", r);
   };
 }
 
 // URI-reference = URI / relative-ref
-auto URI_reference (uri::parts& result) {
-  return [&result] (rule const& r) {
-    return r.alternative (URI (result), relative_ref (result))
+auto URI_reference (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
+    return r.alternative (URI (result, options), relative_ref (result, options))
       .matched ("URI-reference", r);
   };
 }
 
-#if 0
 // absolute-URI  = scheme ":" hier-part [ "?" query ]
-auto absolute_URI (uri::parts& result) {
-  return [&result] (rule const& r) {
+auto absolute_URI (uri::parts& result, split_options const& options) {
+  return [&result, &options] (rule const& r) {
     return r
       .concat (
         scheme,
         [&result] (std::string_view const scheme) { result.scheme = scheme; })
       .concat (colon)
-      .concat (hier_part (result))
-      .optional (question_query (result))
+      .concat (hier_part (result, options))
+      .optional (question_query (result, options))
       .matched ("absolute-URI", r);
   };
 }
-#endif
+
+// origin-form    = absolute-path [ "?" query ]
+// absolute-path  = 1*( "/" segment )
+//
+// The origin-form is matched by a hand-written loop rather than the rule
+// productions since it is the form used by almost every HTTP request.
+bool origin_form (std::string_view const in, split_options const& options,
+                  uri::parts& result) {
+  using details::is;
+  using details::skip;
+  assert (!in.empty () && in.front () == '/');
+  auto const size = in.size ();
+  auto& segments = result.path.segments;
+  result.path.absolute = true;
+  auto first = std::size_t{1};  // The start of the current segment.
+  auto pos = first;
+  for (;;) {
+    pos = skip (in, pos, details::pchar);
+    if (pos < size && in[pos] == '%') {
+      if (pos + 2U >= size || !is (in[pos + 1U], details::hex_char) ||
+          !is (in[pos + 2U], details::hex_char)) {
+        return false;
+      }
+      pos += 3U;
+      continue;
+    }
+    // The end of a segment.
+    if (segments.size () >= options.max_segments) {
+      return false;
+    }
+    segments.push_back (in.substr (first, pos - first));
+    if (pos == size) {
+      return true;
+    }
+    if (in[pos] != '/') {
+      break;
+    }
+    ++pos;
+    first = pos;
+  }
+  if (in[pos] != '?' || size - pos - 1U > options.max_query_length) {
+    return false;
+  }
+  ++pos;
+  auto const query_first = pos;
+  for (;;) {
+    pos = skip (in, pos, details::query_char);
+    if (pos == size) {
+      break;
+    }
+    if (in[pos] != '%' || pos + 2U >= size ||
+        !is (in[pos + 1U], details::hex_char) ||
+        !is (in[pos + 2U], details::hex_char)) {
+      return false;
+    }
+    pos += 3U;
+  }
+  result.query = in.substr (query_first);
+  return true;
+}
+
+/// Returns true if \p in has the shape of the authority-form: a host (which
+/// cannot begin with a scheme) or a single colon followed by a port.
+bool is_authority_form (std::string_view const in) {
+  assert (!in.empty ());
+  if (!g::alpha::test (in.front ())) {
+    return true;
+  }
+  auto const colon = in.find (':');
+  if (colon == std::string_view::npos ||
+      in.find (':', colon + 1U) != std::string_view::npos) {
+    return false;
+  }
+  auto const port = in.substr (colon + 1U);
+  return std::all_of (std::begin (port), std::end (port), g::digit::test);
+}
 
 // merge
 // ~~~~~
@@ -661,7 +793,7 @@ struct uri::parts::path merge (uri::parts const& base, uri::parts const& ref) {
   r2.absolute = base.path.absolute;
 
   auto last = std::end (base.path.segments);
-  if (base.path.segments.size () > 1) {
+  if (!base.path.segments.empty ()) {
     std::advance (last, -1);
   }
   auto out = std::back_inserter (r2.segments);
@@ -670,6 +802,65 @@ struct uri::parts::path merge (uri::parts const& base, uri::parts const& ref) {
   return r2;
 }
 
+// path length
+// ~~~~~~~~~~~
+/// Returns the number of characters that compose() will produce for the path
+/// made from the segments [first, last).
+template <typename Iterator>
+std::size_t path_length (Iterator first, Iterator last, bool absolute) {
+  if (first == last) {
+    return 0;
+  }
+  auto const separators =
+    static_cast<std::size_t> (std::distance (first, last)) - (absolute ? 0 : 1);
+  return std::accumulate (first, last, separators,
+                          [] (std::size_t acc, std::string_view const seg) {
+                            return acc + seg.length ();
+                          });
+}
+
+// relative path
+// ~~~~~~~~~~~~~
+/// Builds a relative-path reference which, when merged with the directory of
+/// \p base, yields the absolute path \p target.
+struct uri::parts::path relative_path (struct uri::parts::path const& base,
+                                       struct uri::parts::path const& target) {
+  assert (!target.empty ());
+  // The "directory" of the base path is all but its final segment. The final
+  // segment of the target is always part of the reference.
+  auto const base_dir_end = base.empty () ? std::end (base.segments)
+                                          : std::prev (std::end (base.segments));
+  auto const [base_pos, target_pos] =
+    std::mismatch (std::begin (base.segments), base_dir_end,
+                   std::begin (target.segments),
+                   std::prev (std::end (target.segments)));
+
+  struct uri::parts::path ref;
+  auto const ups =
+    static_cast<std::size_t> (std::distance (base_pos, base_dir_end));
+  ref.segments.reserve (ups + 1U + static_cast<std::size_t> (std::distance (
+                                     target_pos, std::end (target.segments))));
+  ref.segments.insert (std::end (ref.segments), ups, ".."sv);
+  if (ups == 0) {
+    auto const& first = *target_pos;
+    if (first.empty () &&
+        target_pos == std::prev (std::end (target.segments))) {
+      // An empty reference would refer to the base itself. "." names its
+      // directory.
+      ref.segments.emplace_back ("."sv);
+      return ref;
+    }
+    // A leading empty segment would compose as an absolute path and a colon in
+    // the first segment would be mistaken for a scheme: "./" avoids both.
+    if (first.empty () || first.find (':') != std::string_view::npos) {
+      ref.segments.emplace_back ("."sv);
+    }
+  }
+  ref.segments.insert (std::end (ref.segments), target_pos,
+                       std::end (target.segments));
+  return ref;
+}
+
 }  // end anonymous namespace
 
 namespace uri {
@@ -810,13 +1001,96 @@ bool parts::operator== (parts const& rhs) const {
 }
 
 std::optional<parts> split (std::string_view const in) {
-  if (parts result;
-      rule{in}.alternative (URI (result), URI_reference (result)).done ()) {
+  return split (in, split_options{});
+}
+
+std::optional<parts> split (std::string_view const in,
+                            split_options const& options) {
+  if (in.length () > options.max_length) {
+    return {};
+  }
+  if (parts result; rule{in}
+                      .alternative (URI (result, options),
+                                    URI_reference (result, options))
+                      .done ()) {
     return result;
   }
   return {};
 }
 
+split_result split_with_diagnostics (std::string_view const in,
+                                     split_options const& options) {
+  if (in.length () > options.max_length) {
+    return split_error{options.max_length, "URI-reference"};
+  }
+  furthest_failure failure;
+  if (parts result; rule{in, failure}
+                      .alternative (URI (result, options),
+                                    URI_reference (result, options))
+                      .done ()) {
+    return result;
+  }
+  split_error error;
+  if (char const* const pos = failure.position ()) {
+    error.offset = static_cast<std::size_t> (pos - in.data ());
+  }
+  char const* const production = failure.production ();
+  error.production = production != nullptr ? production : "URI-reference";
+  return error;
+}
+
+std::optional<request_target> parse_request_target (
+  std::string_view const in, split_options const& options) {
+  if (in.empty () || in.length () > options.max_length) {
+    return {};
+  }
+  request_target result;
+  auto& parts = result.parts;
+  switch (in.front ()) {
+  case '/':
+    result.form = request_target_form::origin;
+    if (!origin_form (in, options, parts)) {
+      return {};
+    }
+    return result;
+  case '*':
+    if (in.length () != 1U || options.max_segments == 0U) {
+      return {};
+    }
+    result.form = request_target_form::asterisk;
+    parts.path.segments.emplace_back (in);
+    return result;
+  default: break;
+  }
+  if (is_authority_form (in)) {
+    // authority-form = uri-host ":" port
+    result.form = request_target_form::authority;
+    if (!rule{in}
+           .concat (host_rule (parts, options))
+           .concat (colon_port (parts))
+           .done ()) {
+      return {};
+    }
+    return result;
+  }
+  // absolute-form = absolute-URI
+  result.form = request_target_form::absolute;
+  if (!rule{in}
+         .concat (absolute_URI (parts, options))
+         .done ()) {
+    return {};
+  }
+  return result;
+}
+
+namespace details {
+
+bool is_host (std::string_view const host) {
+  return rule{host}.concat (hostfn).done ();
+}
+
+}  // end namespace details
+
 std::ostream& operator<< (std::ostream& os,
                           struct parts::authority const& auth) {
   if (auth.userinfo.has_value ()) {
@@ -901,6 +1175,93 @@ std::optional<parts> join (std::string_view base, std::string_view reference,
   return join (*base_parts, *reference_parts, strict);
 }
 
+// make relative
+// ~~~~~~~~~~~~~
+/// Produces the shortest URI reference which, when resolved against \p base
+/// by join(), yields \p target. This is the inverse of join().
+///
+/// \param base  The base URI.
+/// \param target  The target URI. This should not contain dot-segments.
+/// \result  A reference to the target relative to the base URI.
+parts make_relative (parts const& base, parts const& target) {
+  if (target.scheme != base.scheme) {
+    return target;
+  }
+  parts ref;
+  ref.fragment = target.fragment;
+  if (target.authority != base.authority) {
+    if (!target.authority) {
+      return target;
+    }
+    // A network-path reference.
+    ref.authority = target.authority;
+    ref.path = target.path;
+    ref.query = target.query;
+    return ref;
+  }
+
+  bool const same_path = base.authority
+                           ? base.path.segments == target.path.segments
+                           : base.path == target.path;
+  if (same_path) {
+    if (target.query == base.query) {
+      return ref;
+    }
+    if (target.query) {
+      ref.query = target.query;
+      return ref;
+    }
+    // The base has a query but the target does not: an empty path would
+    // inherit the base query so the path must be spelled out.
+  }
+
+  ref.query = target.query;
+  if (target.path.empty ()) {
+    // Only a network-path reference can yield an empty path.
+    if (!target.authority) {
+      return target;
+    }
+    ref.authority = target.authority;
+    return ref;
+  }
+  bool const base_absolute = base.path.absolute || base.authority.has_value ();
+  bool const target_absolute =
+    target.path.absolute || target.authority.has_value ();
+  if (!base_absolute || !target_absolute) {
+    return target;
+  }
+
+  struct parts::path const& target_path = target.path;
+  auto rel = relative_path (base.path, target_path);
+  auto const& segs = rel.segments;
+  // An absolute-path reference cannot begin "//" because that would introduce
+  // an authority. Otherwise prefer the shorter of the two forms.
+  if ((target_path.segments.size () > 1 &&
+       target_path.segments.front ().empty ()) ||
+      path_length (std::begin (segs), std::end (segs), false) <=
+        path_length (std::begin (target_path.segments),
+                     std::end (target_path.segments), true)) {
+    ref.path = std::move (rel);
+  } else {
+    ref.path.absolute = true;
+    ref.path.segments = target_path.segments;
+  }
+  return ref;
+}
+
+std::optional<parts> make_relative (std::string_view base,
+                                    std::string_view target) {
+  auto const base_parts = split (base);
+  if (!base_parts) {
+    return {};
+  }
+  auto const target_parts = split (target);
+  if (!target_parts) {
+    return {};
+  }
+  return make_relative (*base_parts, *target_parts);
+}
+
 std::ostream& compose (std::ostream& os, parts const& p) {
   // assert (!p.authority || p.path.absolute);
 
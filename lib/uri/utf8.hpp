@@ -0,0 +1,456 @@
+//===- lib/uri/utf8.hpp -----------------------------------*- mode: C++ -*-===//
+//*        _    __  ___   *
+//*  _   _| |_ / _|( _ )  *
+//* | | | | __| |_ / _ \  *
+//* | |_| | |_|  _| (_) | *
+//*  \__,_|\__|_|  \___/  *
+//*                       *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+/// \file utf8.hpp
+/// \brief UTF-8 validation and transcoding.
+///
+/// Two validators are provided: an incremental scalar validator to which bytes
+/// are presented one at a time, and a vectorized validator which checks 16
+/// bytes at a time using the lookup-table algorithm described by Keiser and
+/// Lemire in "Validating UTF-8 In Less Than One Instruction Per Byte" (and
+/// used by simdjson and simdutf). The transcoders between UTF-8 and UTF-32
+/// convert runs of ASCII 16 code units at a time.
+#ifndef URI_UTF8_HPP
+#define URI_UTF8_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.hpp"
+
+#if URI_SIMD_SSE2
+#include <tmmintrin.h>
+#endif
+
+namespace uri::utf8 {
+
+constexpr bool is_continuation (char const c) noexcept {
+  return (static_cast<unsigned char> (c) & 0xC0U) == 0x80U;
+}
+
+/// An incremental UTF-8 validator. Bytes are presented one at a time (or as
+/// runs) and the validator tracks the sequence that they form. The accepted
+/// sequences are those of table 3-7 in the Unicode Standard.
+class validator {
+public:
+  /// Presents the byte \p c which is at offset \p offset of the input.
+  /// Returns false if it cannot form part of a well-formed sequence.
+  bool step (unsigned char const c, std::size_t const offset) noexcept {
+    if (need_ == 0U) {
+      if (c < 0x80U) {
+        return true;
+      }
+      start_ = offset;
+      lo_ = 0x80U;
+      hi_ = 0xBFU;
+      if (c >= 0xC2U && c <= 0xDFU) {
+        need_ = 1U;
+      } else if (c >= 0xE0U && c <= 0xEFU) {
+        need_ = 2U;
+        if (c == 0xE0U) {
+          lo_ = 0xA0U;  // Reject overlong encodings.
+        } else if (c == 0xEDU) {
+          hi_ = 0x9FU;  // Reject surrogates.
+        }
+      } else if (c >= 0xF0U && c <= 0xF4U) {
+        need_ = 3U;
+        if (c == 0xF0U) {
+          lo_ = 0x90U;  // Reject overlong encodings.
+        } else if (c == 0xF4U) {
+          hi_ = 0x8FU;  // Reject code points beyond U+10FFFF.
+        }
+      } else {
+        return false;
+      }
+      return true;
+    }
+    if (c < lo_ || c > hi_) {
+      return false;
+    }
+    lo_ = 0x80U;
+    hi_ = 0xBFU;
+    --need_;
+    return true;
+  }
+
+  /// Presents the run of bytes [first, last) which begins at offset \p offset
+  /// of the input. Runs of ASCII are skipped in bulk.
+  bool run (char const* first, char const* const last,
+            std::size_t offset) noexcept {
+    while (first != last) {
+      if (need_ == 0U) {
+        auto const* const non_ascii = simd::find_non_ascii (first, last);
+        offset += static_cast<std::size_t> (non_ascii - first);
+        first = non_ascii;
+        if (first == last) {
+          break;
+        }
+      }
+      if (!this->step (static_cast<unsigned char> (*first), offset)) {
+        return false;
+      }
+      ++first;
+      ++offset;
+    }
+    return true;
+  }
+
+  /// Returns true if the bytes presented so far do not end with an incomplete
+  /// sequence.
+  constexpr bool complete () const noexcept { return need_ == 0U; }
+  /// Returns the input offset of the first byte of the current sequence.
+  constexpr std::size_t start () const noexcept { return start_; }
+
+private:
+  unsigned need_ = 0;  ///< The number of continuation bytes still expected.
+  unsigned lo_ = 0x80U;  ///< The smallest acceptable next byte.
+  unsigned hi_ = 0xBFU;  ///< The largest acceptable next byte.
+  std::size_t start_ = 0;
+};
+
+/// Converts the well-formed UTF-8 [first, last) to code points which are
+/// written to \p out. There must be room for last - first code points.
+/// Returns the end of the output.
+inline char32_t* decode_valid (char const* first, char const* const last,
+                               char32_t* out) noexcept {
+  while (first != last) {
+#if URI_SIMD_SSE2
+    if (last - first >= static_cast<std::ptrdiff_t> (simd::block_size)) {
+      // Widen 16 bytes to code points. There is room for all 16 because the
+      // output is never longer than the input which remains but only the
+      // leading ASCII bytes are kept.
+      auto const block = simd::load (first);
+      auto const zero = _mm_setzero_si128 ();
+      auto const lo = _mm_unpacklo_epi8 (block, zero);
+      auto const hi = _mm_unpackhi_epi8 (block, zero);
+      simd::store (out, _mm_unpacklo_epi16 (lo, zero));
+      simd::store (out + 4, _mm_unpackhi_epi16 (lo, zero));
+      simd::store (out + 8, _mm_unpacklo_epi16 (hi, zero));
+      simd::store (out + 12, _mm_unpackhi_epi16 (hi, zero));
+      auto const mask =
+        static_cast<std::uint32_t> (_mm_movemask_epi8 (block));
+      auto const ascii = mask == 0U ? simd::block_size
+                                    : std::size_t{simd::countr_zero (mask)};
+      first += ascii;
+      out += ascii;
+      if (mask == 0U) {
+        continue;
+      }
+    }
+#endif  // URI_SIMD_SSE2
+    auto const c = static_cast<unsigned char> (*(first++));
+    if (c < 0x80U) {
+      *(out++) = c;
+      continue;
+    }
+    // The number of continuation bytes that follow.
+    auto extra = c >= 0xF0U ? 3U : c >= 0xE0U ? 2U : 1U;
+    auto cp = static_cast<char32_t> (c & (0x3FU >> extra));
+    for (; extra > 0U; --extra) {
+      cp = static_cast<char32_t> (
+        (cp << 6U) | (static_cast<unsigned char> (*(first++)) & 0x3FU));
+    }
+    *(out++) = cp;
+  }
+  return out;
+}
+
+#if URI_SIMD_SSE2
+
+/// A vectorized UTF-8 validator. Blocks of 16 bytes are presented in order
+/// and errors are accumulated: the validator reports whether an error was
+/// found but not where.
+///
+/// The member functions use SSSE3 instructions and must only be called if
+/// simd::has_ssse3() returns true.
+class block_validator {
+public:
+  URI_SIMD_TARGET_SSSE3 block_validator () noexcept
+      : error_{_mm_setzero_si128 ()},
+        prev_input_{_mm_setzero_si128 ()},
+        prev_incomplete_{_mm_setzero_si128 ()} {}
+
+  /// Presents the next 16 bytes of input.
+  URI_SIMD_TARGET_SSSE3 void block (__m128i const input) noexcept {
+    if (_mm_movemask_epi8 (input) == 0) {
+      // All ASCII: the only possible error is a sequence left incomplete by
+      // the previous block.
+      error_ = _mm_or_si128 (error_, prev_incomplete_);
+      prev_incomplete_ = _mm_setzero_si128 ();
+    } else {
+      error_ = _mm_or_si128 (error_, check_block (input, prev_input_));
+      prev_incomplete_ = is_incomplete (input);
+    }
+    prev_input_ = input;
+  }
+
+  /// Presents the final bytes of the input [first, last) where there are
+  /// fewer than 16 of them and checks that the input does not end with an
+  /// incomplete sequence.
+  URI_SIMD_TARGET_SSSE3 void finish (char const* const first,
+                                     char const* const last) noexcept {
+    if (first != last) {
+      std::array<char, simd::block_size> buffer{};
+      std::memcpy (buffer.data (), first,
+                   static_cast<std::size_t> (last - first));
+      this->block (simd::load (buffer.data ()));
+    }
+    error_ = _mm_or_si128 (error_, prev_incomplete_);
+  }
+
+  /// Returns true if an error has been found in any of the input presented
+  /// so far.
+  URI_SIMD_TARGET_SSSE3 bool has_error () const noexcept {
+    return _mm_movemask_epi8 (_mm_cmpeq_epi8 (error_, _mm_setzero_si128 ())) !=
+           0xFFFF;
+  }
+
+private:
+  // The error bits used in the lookup tables.
+  static constexpr auto too_short = char{1 << 0};
+  static constexpr auto too_long = char{1 << 1};
+  static constexpr auto overlong_3 = char{1 << 2};
+  static constexpr auto too_large = char{1 << 3};
+  static constexpr auto surrogate = char{1 << 4};
+  static constexpr auto overlong_2 = char{1 << 5};
+  static constexpr auto too_large_1000 = char{1 << 6};
+  static constexpr auto overlong_4 = char{1 << 6};
+  static constexpr auto two_conts = static_cast<char> (1 << 7);
+  static constexpr auto carry = static_cast<char> (too_short | too_long |
+                                                   two_conts);
+
+  /// Returns a block whose bytes are those of \p input preceded by the last
+  /// \p N bytes of \p previous.
+  template <int N>
+  URI_SIMD_TARGET_SSSE3 static __m128i prev (__m128i const input,
+                                             __m128i const previous) noexcept {
+    return _mm_alignr_epi8 (input, previous, 16 - N);
+  }
+
+  /// Returns a block in which each byte is the value of the 16 entry table
+  /// given by the arguments selected by the low four bits of \p index.
+  URI_SIMD_TARGET_SSSE3 static __m128i lookup (
+    __m128i const index, char t0, char t1, char t2, char t3, char t4, char t5,
+    char t6, char t7, char t8, char t9, char t10, char t11, char t12, char t13,
+    char t14, char t15) noexcept {
+    return _mm_shuffle_epi8 (_mm_setr_epi8 (t0, t1, t2, t3, t4, t5, t6, t7, t8,
+                                            t9, t10, t11, t12, t13, t14, t15),
+                             index);
+  }
+
+  URI_SIMD_TARGET_SSSE3 static __m128i high_nibbles (__m128i const v) noexcept {
+    return _mm_and_si128 (_mm_srli_epi16 (v, 4), _mm_set1_epi8 (0x0F));
+  }
+
+  /// Finds errors which can be detected by looking at the first twelve bits
+  /// of each pair of bytes.
+  URI_SIMD_TARGET_SSSE3 static __m128i special_cases (
+    __m128i const input, __m128i const prev1) noexcept {
+    auto const byte_1_high = lookup (
+      high_nibbles (prev1),
+      // 0_______ ________ <ASCII in byte 1>
+      too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+      too_long,
+      // 10______ ________ <continuation in byte 1>
+      two_conts, two_conts, two_conts, two_conts,
+      // 1100____ ________ <two byte lead in byte 1>
+      static_cast<char> (too_short | overlong_2),
+      // 1101____ ________ <two byte lead in byte 1>
+      too_short,
+      // 1110____ ________ <three byte lead in byte 1>
+      static_cast<char> (too_short | overlong_3 | surrogate),
+      // 1111____ ________ <four+ byte lead in byte 1>
+      static_cast<char> (too_short | too_large | too_large_1000 | overlong_4));
+
+    constexpr auto large = static_cast<char> (carry | too_large);
+    constexpr auto large_1000 =
+      static_cast<char> (carry | too_large | too_large_1000);
+    auto const byte_1_low = lookup (
+      _mm_and_si128 (prev1, _mm_set1_epi8 (0x0F)),
+      // ____0000 ________
+      static_cast<char> (carry | overlong_3 | overlong_2 | overlong_4),
+      // ____0001 ________
+      static_cast<char> (carry | overlong_2),
+      // ____001_ ________
+      carry, carry,
+      // ____0100 ________
+      large,
+      // ____0101 ________
+      large_1000,
+      // ____011_ ________
+      large_1000, large_1000,
+      // ____1___ ________
+      large_1000, large_1000, large_1000, large_1000, large_1000,
+      // ____1101 ________
+      static_cast<char> (large_1000 | surrogate),
+      // ____111_ ________
+      large_1000, large_1000);
+
+    constexpr auto cont_1000 =
+      static_cast<char> (too_long | overlong_2 | two_conts | overlong_3 |
+                         too_large_1000 | overlong_4);
+    constexpr auto cont_1001 = static_cast<char> (
+      too_long | overlong_2 | two_conts | overlong_3 | too_large);
+    constexpr auto cont_101 = static_cast<char> (too_long | overlong_2 |
+                                                 two_conts | surrogate |
+                                                 too_large);
+    auto const byte_2_high = lookup (
+      high_nibbles (input),
+      // ________ 0_______ <ASCII in byte 2>
+      too_short, too_short, too_short, too_short, too_short, too_short,
+      too_short, too_short,
+      // ________ 1000____ <continuation in byte 2>
+      cont_1000,
+      // ________ 1001____
+      cont_1001,
+      // ________ 101_____
+      cont_101, cont_101,
+      // ________ 11______ <lead byte in byte 2>
+      too_short, too_short, too_short, too_short);
+
+    return _mm_and_si128 (_mm_and_si128 (byte_1_high, byte_1_low),
+                          byte_2_high);
+  }
+
+  /// Checks that the third and fourth bytes of three and four byte sequences
+  /// are continuations (and that no other bytes are).
+  URI_SIMD_TARGET_SSSE3 static __m128i multibyte_lengths (
+    __m128i const input, __m128i const prev_input,
+    __m128i const sc) noexcept {
+    auto const prev2 = prev<2> (input, prev_input);
+    auto const prev3 = prev<3> (input, prev_input);
+    // Bytes which follow a three or four byte lead by two positions and
+    // bytes which follow a four byte lead by three positions.
+    auto const is_third_byte =
+      _mm_subs_epu8 (prev2, _mm_set1_epi8 (static_cast<char> (0xE0 - 1)));
+    auto const is_fourth_byte =
+      _mm_subs_epu8 (prev3, _mm_set1_epi8 (static_cast<char> (0xF0 - 1)));
+    auto const must_be_23_continuation =
+      _mm_cmpgt_epi8 (_mm_or_si128 (is_third_byte, is_fourth_byte),
+                      _mm_setzero_si128 ());
+    auto const must_be_23_80 = _mm_and_si128 (
+      must_be_23_continuation, _mm_set1_epi8 (static_cast<char> (0x80)));
+    return _mm_xor_si128 (must_be_23_80, sc);
+  }
+
+  URI_SIMD_TARGET_SSSE3 static __m128i check_block (
+    __m128i const input, __m128i const prev_input) noexcept {
+    auto const sc = special_cases (input, prev<1> (input, prev_input));
+    return multibyte_lengths (input, prev_input, sc);
+  }
+
+  /// Returns a non-zero block if the last bytes of \p input begin a sequence
+  /// which is not completed within the block.
+  URI_SIMD_TARGET_SSSE3 static __m128i is_incomplete (
+    __m128i const input) noexcept {
+    // The last byte may not be a lead byte, the second to last may not be the
+    // lead of a three or four byte sequence, and the third to last may not be
+    // the lead of a four byte sequence.
+    auto const max_value = _mm_setr_epi8 (
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      static_cast<char> (0xF0 - 1), static_cast<char> (0xE0 - 1),
+      static_cast<char> (0xC0 - 1));
+    return _mm_subs_epu8 (input, max_value);
+  }
+
+  __m128i error_;
+  __m128i prev_input_;
+  __m128i prev_incomplete_;
+};
+
+#endif  // URI_SIMD_SSE2
+
+/// Returns true if [first, last) is well-formed UTF-8.
+inline bool is_valid (char const* first, char const* const last) noexcept {
+#if URI_SIMD_SSE2
+  if (simd::has_ssse3 ()) {
+    block_validator v;
+    for (; last - first >= static_cast<std::ptrdiff_t> (simd::block_size);
+         first += simd::block_size) {
+      v.block (simd::load (first));
+    }
+    v.finish (first, last);
+    return !v.has_error ();
+  }
+#endif  // URI_SIMD_SSE2
+  validator v;
+  return v.run (first, last, 0) && v.complete ();
+}
+
+/// Converts the UTF-8 [first, last) to code points which are written to
+/// \p out. There must be room for last - first code points. Returns the end
+/// of the output or nullptr if the input is not well-formed.
+inline char32_t* to_utf32 (char const* const first, char const* const last,
+                           char32_t* const out) noexcept {
+  return is_valid (first, last) ? decode_valid (first, last, out) : nullptr;
+}
+
+/// Converts the code points [first, last) to UTF-8 which is written to
+/// \p out. There must be room for 4 * (last - first) bytes. Returns the end
+/// of the output or nullptr if one of the code points is not a Unicode scalar
+/// value.
+inline char* to_utf8 (char32_t const* first, char32_t const* const last,
+                      char* out) noexcept {
+  auto const unit = [] (std::uint_least32_t const v) {
+    return static_cast<char> (static_cast<unsigned char> (v));
+  };
+  while (first != last) {
+#if URI_SIMD_SSE2
+    if (last - first >= static_cast<std::ptrdiff_t> (simd::block_size)) {
+      auto const a = simd::load (first);
+      auto const b = simd::load (first + 4);
+      auto const c = simd::load (first + 8);
+      auto const d = simd::load (first + 12);
+      auto const high_bits =
+        _mm_and_si128 (_mm_or_si128 (_mm_or_si128 (a, b), _mm_or_si128 (c, d)),
+                       _mm_set1_epi32 (~0x7F));
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (
+            high_bits, _mm_setzero_si128 ())) == 0xFFFF) {
+        // All 16 code points are ASCII: narrow them to bytes.
+        simd::store (out, _mm_packus_epi16 (_mm_packs_epi32 (a, b),
+                                            _mm_packs_epi32 (c, d)));
+        first += simd::block_size;
+        out += simd::block_size;
+        continue;
+      }
+    }
+#endif  // URI_SIMD_SSE2
+    auto const cp = *(first++);
+    if (cp < 0x80) {
+      *(out++) = unit (cp);
+    } else if (cp < 0x800) {
+      *(out++) = unit (0xC0U | (cp >> 6U));
+      *(out++) = unit (0x80U | (cp & 0x3FU));
+    } else if (cp < 0x10000) {
+      if (cp >= 0xD800 && cp <= 0xDFFF) {
+        return nullptr;
+      }
+      *(out++) = unit (0xE0U | (cp >> 12U));
+      *(out++) = unit (0x80U | ((cp >> 6U) & 0x3FU));
+      *(out++) = unit (0x80U | (cp & 0x3FU));
+    } else if (cp <= 0x10FFFF) {
+      *(out++) = unit (0xF0U | (cp >> 18U));
+      *(out++) = unit (0x80U | ((cp >> 12U) & 0x3FU));
+      *(out++) = unit (0x80U | ((cp >> 6U) & 0x3FU));
+      *(out++) = unit (0x80U | (cp & 0x3FU));
+    } else {
+      return nullptr;
+    }
+  }
+  return out;
+}
+
+}  // end namespace uri::utf8
+
+#endif  // URI_UTF8_HPP
@@ -10,65 +10,325 @@
 // See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
 // SPDX-License-Identifier: MIT
 //===----------------------------------------------------------------------===//
+#include <algorithm>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
 #include <fstream>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include <thread>
+#include <vector>
 
+#include "uri/trace.hpp"
 #include "uri/uri.hpp"
 
 using namespace std::literals::string_literals;
 
 namespace {
 
+/// Writes the components of the URI \p line to \p os.
+///
+/// \returns False if \p line is not a valid URI.
+bool write_components (std::ostream& os, std::string_view const line) {
+  os << "URI: " << line << '\n';
+
+  auto r = uri::split (line);
+  if (!r) {
+    return false;
+  }
+  auto value_or_none = [] (std::optional<std::string_view> const& s) {
+    if (!s) {
+      return "None"s;
+    }
+    std::string result;
+    result.reserve (s->size () + 2U);
+    result += '"';
+    result += *s;
+    result += '"';
+    return result;
+  };
+  os << " scheme: " << value_or_none (r->scheme);
+  if (r->authority.has_value ()) {
+    os << "\n userinfo: " << value_or_none (r->authority->userinfo)
+       << "\n host: " << value_or_none (r->authority->host)
+       << "\n port: " << value_or_none (r->authority->port);
+  } else {
+    os << "\n userinfo: None"
+       << "\n host: None"
+       << "\n port: None";
+  }
+  os << "\n path: " << std::quoted (static_cast<std::string> (r->path))
+     << "\n query: " << value_or_none (r->query)
+     << "\n fragment: " << value_or_none (r->fragment) << '\n';
+  return true;
+}
+
 bool read_stream (std::istream& is) {
   std::string line;
   while (getline (is, line)) {
-    std::cout << "URI: " << line << '\n';
+    if (!write_components (std::cout, line)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// parallel mode
+// ~~~~~~~~~~~~~
+/// The output produced for a chunk of input lines.
+struct chunk_result {
+  std::string output;
+  /// False if one of the lines was not a valid URI. The output stops after
+  /// that line.
+  bool ok = true;
+};
+
+/// Produces the output for each of the lines in \p chunk exactly as
+/// read_stream() would.
+chunk_result parse_chunk (std::string_view chunk) {
+  chunk_result result;
+  std::ostringstream os;
+  while (!chunk.empty ()) {
+    auto const nl = chunk.find ('\n');
+    if (!write_components (os, chunk.substr (0, nl))) {
+      result.ok = false;
+      break;
+    }
+    chunk.remove_prefix (nl == std::string_view::npos ? chunk.size ()
+                                                      : nl + 1U);
+  }
+  result.output = os.str ();
+  return result;
+}
+
+/// A fixed set of worker threads which parse chunks in the order in which
+/// they were submitted.
+class thread_pool {
+public:
+  explicit thread_pool (unsigned const threads) {
+    try {
+      workers_.reserve (threads);
+      for (auto ctr = 0U; ctr < threads; ++ctr) {
+        workers_.emplace_back ([this] { this->run (); });
+      }
+    } catch (...) {
+      // The destructor won't run: the threads that were started must be
+      // joined here.
+      this->stop ();
+      throw;
+    }
+  }
+  thread_pool (thread_pool const&) = delete;
+  thread_pool (thread_pool&&) noexcept = delete;
+  /// Waits for the workers to finish their current tasks. Any tasks which
+  /// have not been started are abandoned.
+  ~thread_pool () noexcept { this->stop (); }
+
+  thread_pool& operator= (thread_pool const&) = delete;
+  thread_pool& operator= (thread_pool&&) noexcept = delete;
+
+  std::future<chunk_result> submit (std::string chunk) {
+    std::packaged_task<chunk_result ()> task{
+      [c = std::move (chunk)] { return parse_chunk (c); }};
+    auto result = task.get_future ();
+    {
+      std::lock_guard<std::mutex> const lock{mutex_};
+      tasks_.push_back (std::move (task));
+    }
+    cv_.notify_one ();
+    return result;
+  }
+
+private:
+  /// Tells the workers to stop and waits for them to exit.
+  void stop () noexcept {
+    {
+      std::lock_guard<std::mutex> const lock{mutex_};
+      stop_ = true;
+    }
+    cv_.notify_all ();
+    for (auto& w : workers_) {
+      w.join ();
+    }
+  }
+
+  void run () {
+    for (;;) {
+      std::packaged_task<chunk_result ()> task;
+      {
+        std::unique_lock<std::mutex> lock{mutex_};
+        cv_.wait (lock, [this] { return stop_ || !tasks_.empty (); });
+        if (stop_) {
+          return;
+        }
+        task = std::move (tasks_.front ());
+        tasks_.pop_front ();
+      }
+      task ();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::deque<std::packaged_task<chunk_result ()>> tasks_;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
 
-    auto r = uri::split (line);
-    if (!r) {
+/// The number of bytes read from the input for each chunk.
+constexpr auto chunk_size = std::size_t{1} << 20U;
+
+/// Reads the next chunk of whole lines from \p is. A partial line at the end
+/// of the chunk is removed and stored in \p carry to begin the next chunk.
+std::string read_chunk (std::istream& is, std::string& carry) {
+  std::string chunk = std::move (carry);
+  carry.clear ();
+  auto const old_size = chunk.size ();
+  chunk.resize (old_size + chunk_size);
+  is.read (chunk.data () + old_size, static_cast<std::streamsize> (chunk_size));
+  chunk.resize (old_size + static_cast<std::size_t> (is.gcount ()));
+  if (is) {
+    // Not yet at the end of the input so the last line may be incomplete.
+    auto const nl = chunk.rfind ('\n');
+    if (nl == std::string::npos) {
+      carry = std::move (chunk);
+      return {};
+    }
+    carry.assign (chunk, nl + 1U, std::string::npos);
+    chunk.resize (nl + 1U);
+  }
+  return chunk;
+}
+
+/// Equivalent to read_stream() but the input is divided into chunks at line
+/// boundaries and the chunks are parsed concurrently by \p jobs threads. The
+/// output is written in the original order.
+bool read_stream_parallel (std::istream& is, unsigned const jobs) {
+  thread_pool pool{jobs};
+  std::deque<std::future<chunk_result>> pending;
+  // Writes the output of the oldest chunk.
+  auto const write_oldest = [&pending] {
+    chunk_result const r = pending.front ().get ();
+    pending.pop_front ();
+    std::cout.write (r.output.data (),
+                     static_cast<std::streamsize> (r.output.size ()));
+    return r.ok;
+  };
+
+  std::string carry;
+  while (is) {
+    std::string chunk = read_chunk (is, carry);
+    if (chunk.empty ()) {
+      continue;
+    }
+    pending.push_back (pool.submit (std::move (chunk)));
+    // Limit the amount of input held in memory to 2 * jobs chunks.
+    if (pending.size () >= std::size_t{2} * jobs && !write_oldest ()) {
+      return false;
+    }
+  }
+  while (!pending.empty ()) {
+    if (!write_oldest ()) {
       return false;
     }
-    auto value_or_none = [] (std::optional<std::string_view> const& s) {
-      return s ? "\""s + std::string{s.value ()} + "\""s : "None"s;
-    };
-    std::cout << " scheme: " << value_or_none (r->scheme);
-    if (r->authority.has_value ()) {
-      std::cout << "\n userinfo: " << value_or_none (r->authority->userinfo)
-                << "\n host: " << value_or_none (r->authority->host)
-                << "\n port: " << value_or_none (r->authority->port);
-    } else {
-      std::cout << "\n userinfo: None"
-                << "\n host: None"
-                << "\n port: None";
-    }
-    std::cout << "\n path: " << std::quoted (static_cast<std::string> (r->path))
-              << "\n query: " << value_or_none (r->query)
-              << "\n fragment: " << value_or_none (r->fragment) << '\n';
   }
   return true;
 }
 
+/// Parses the argument of --jobs. Zero means one thread per hardware thread
+/// and larger values are limited to four threads per hardware thread.
+///
+/// \returns The number of threads or std::nullopt if \p str is not a
+///   non-negative decimal number.
+std::optional<unsigned> parse_jobs (std::string_view const str) {
+  auto const hardware = std::max (std::thread::hardware_concurrency (), 1U);
+  auto const max_jobs = 4U * hardware;
+  auto jobs = 0U;
+  auto const* const last = str.data () + str.size ();
+  auto const [ptr, ec] = std::from_chars (str.data (), last, jobs);
+  if (ptr != last ||
+      (ec != std::errc{} && ec != std::errc::result_out_of_range)) {
+    return std::nullopt;
+  }
+  if (ec == std::errc::result_out_of_range || jobs > max_jobs) {
+    return max_jobs;
+  }
+  return jobs == 0U ? hardware : jobs;
+}
+
+enum class trace_format { none, table, json };
+
+/// Writes the grammar production counters to stderr in the requested format.
+void write_trace (trace_format const format) {
+  switch (format) {
+  case trace_format::none: break;
+  case trace_format::table: uri::trace::write_table (std::cerr); break;
+  case trace_format::json: uri::trace::write_json (std::cerr); break;
+  }
+}
+
 }  // end anonymous namespace
 
 int main (int argc, char const* argv[]) {
   int exit_code = EXIT_SUCCESS;
   try {
-    if (argc == 1) {
-      return read_stream (std::cin) ? EXIT_SUCCESS : EXIT_FAILURE;
+    auto trace = trace_format::none;
+    auto jobs = 1U;
+    int arg = 1;
+    for (; arg < argc; ++arg) {
+      auto const a = std::string_view{argv[arg]};
+      if (a == "--trace") {
+        trace = trace_format::table;
+      } else if (a == "--trace-json") {
+        trace = trace_format::json;
+      } else if (a == "--jobs" || a == "-j") {
+        if (++arg == argc) {
+          std::cerr << "Error: " << a << " needs a number of threads\n";
+          return EXIT_FAILURE;
+        }
+        auto const j = parse_jobs (argv[arg]);
+        if (!j) {
+          std::cerr << "Error: " << a << " needs a number of threads, not \""
+                    << argv[arg] << "\"\n";
+          return EXIT_FAILURE;
+        }
+        jobs = *j;
+      } else {
+        break;
+      }
+    }
+    auto const read = [jobs] (std::istream& is) {
+      return jobs > 1U ? read_stream_parallel (is, jobs) : read_stream (is);
+    };
+    if (trace != trace_format::none) {
+      if (!uri::trace::available) {
+        std::cerr << "Error: tracing needs a build with URI_TRACE enabled\n";
+        return EXIT_FAILURE;
+      }
+      uri::trace::enable ();
     }
 
-    for (int arg = 1; arg < argc; ++arg) {
+    if (arg == argc) {
+      exit_code = read (std::cin) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    for (; arg < argc && exit_code == EXIT_SUCCESS; ++arg) {
       std::filesystem::path const p = argv[arg];
       std::ifstream infile{p};
       if (!infile.is_open ()) {
         std::cerr << "Error: couldn't open " << p << '\n';
         return EXIT_FAILURE;
       }
-      if (!read_stream (infile)) {
-        return EXIT_FAILURE;
+      if (!read (infile)) {
+        exit_code = EXIT_FAILURE;
       }
     }
+    write_trace (trace);
   } catch (std::exception const& ex) {
     std::cerr << "Error: " << ex.what () << '\n';
     exit_code = EXIT_FAILURE;
@@ -0,0 +1,185 @@
+//===- unittests/uri/test_grammar.cpp -------------------------------------===//
+//*                                                  *
+//*   __ _ _ __ __ _ _ __ ___  _ __ ___   __ _ _ __  *
+//*  / _` | '__/ _` | '_ ` _ \| '_ ` _ \ / _` | '__| *
+//* | (_| | | | (_| | | | | | | | | | | | (_| | |    *
+//*  \__, |_|  \__,_|_| |_| |_|_| |_| |_|\__,_|_|    *
+//*  |___/                                           *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/grammar.hpp"
+
+// google test/fuzz.
+#include <gmock/gmock.h>
+#if URI_FUZZTEST
+#include "fuzztest/fuzztest.h"
+#endif
+
+#include <string>
+#include <vector>
+
+#include "uri/trace.hpp"
+
+namespace g = uri::grammar;
+using testing::ElementsAre;
+
+namespace {
+
+// scheme = ALPHA *( ALPHA / DIGIT / "+" / "-" / "." )
+using scheme =
+  g::seq<g::alpha, g::star<g::alt<g::alpha, g::digit, g::one<'+', '-', '.'>>>>;
+
+// h16 = 1*4HEXDIG
+using h16 = g::rep<1, 4, g::hexdig>;
+
+// pct-encoded = "%" HEXDIG HEXDIG
+constexpr char pct_encoded_name[] = "pct-encoded";
+using pct_encoded =
+  g::named<pct_encoded_name, g::seq<g::ch<'%'>, g::hexdig, g::hexdig>>;
+
+// The grammars are evaluated at compile time.
+static_assert (g::full<scheme> ("git+ssh"));
+static_assert (!g::full<scheme> ("1http"));
+static_assert (g::prefix<scheme> ("http://") == std::string_view{"http"});
+static_assert (!g::prefix<g::digit> ("").has_value ());
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST (Grammar, CharClasses) {
+  EXPECT_TRUE (g::full<g::ch<'a'>> ("a"));
+  EXPECT_FALSE (g::full<g::ch<'a'>> ("A"));
+  EXPECT_TRUE ((g::full<g::one<'x', 'y'>> ("y")));
+  EXPECT_FALSE ((g::full<g::one<'x', 'y'>> ("z")));
+  EXPECT_TRUE ((g::full<g::range<'0', '4'>> ("4")));
+  EXPECT_FALSE ((g::full<g::range<'0', '4'>> ("5")));
+  EXPECT_TRUE (g::full<g::hexdig> ("f"));
+  EXPECT_TRUE (g::full<g::hexdig> ("F"));
+  EXPECT_FALSE (g::full<g::hexdig> ("g"));
+  EXPECT_FALSE (g::full<g::alpha> ("\xC3"));
+  EXPECT_FALSE (g::full<g::any> (""));
+}
+// NOLINTNEXTLINE
+TEST (Grammar, Seq) {
+  using ab = g::seq<g::ch<'a'>, g::ch<'b'>>;
+  EXPECT_EQ (g::prefix<ab> ("abc"), std::string_view{"ab"});
+  EXPECT_FALSE (g::prefix<ab> ("ac").has_value ());
+  EXPECT_FALSE (g::prefix<ab> ("a").has_value ());
+  EXPECT_EQ (g::prefix<g::seq<>> ("a"), std::string_view{});
+}
+// NOLINTNEXTLINE
+TEST (Grammar, Alt) {
+  // The first alternative which matches is taken.
+  using a_or_ab = g::alt<g::ch<'a'>, g::seq<g::ch<'a'>, g::ch<'b'>>>;
+  EXPECT_EQ (g::prefix<a_or_ab> ("ab"), std::string_view{"a"});
+  EXPECT_FALSE (g::prefix<a_or_ab> ("b").has_value ());
+}
+// NOLINTNEXTLINE
+TEST (Grammar, Repetition) {
+  EXPECT_FALSE (g::prefix<h16> ("").has_value ());
+  EXPECT_EQ (g::prefix<h16> ("1"), std::string_view{"1"});
+  EXPECT_EQ (g::prefix<h16> ("12345"), std::string_view{"1234"});
+  EXPECT_EQ (g::prefix<g::star<g::digit>> ("x"), std::string_view{});
+  EXPECT_FALSE (g::prefix<g::plus<g::digit>> ("x").has_value ());
+  EXPECT_EQ (g::prefix<g::opt<g::digit>> ("12"), std::string_view{"1"});
+  // A production which matches the empty string must not loop forever.
+  EXPECT_EQ (g::prefix<g::star<g::opt<g::digit>>> ("12x"),
+             std::string_view{"12"});
+  EXPECT_EQ ((g::prefix<g::rep<3, 5, g::opt<g::digit>>> ("x")),
+             std::string_view{});
+}
+// NOLINTNEXTLINE
+TEST (Grammar, NotAt) {
+  // A colon which is not followed by another.
+  using single_colon = g::seq<g::ch<':'>, g::not_at<g::ch<':'>>>;
+  EXPECT_EQ (g::prefix<single_colon> (":a"), std::string_view{":"});
+  EXPECT_FALSE (g::prefix<single_colon> ("::").has_value ());
+}
+
+namespace {
+
+struct record {
+  void operator() (std::string_view const str,
+                   std::vector<std::string>& ctx) const {
+    ctx.emplace_back (str);
+  }
+};
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST (Grammar, Action) {
+  // key *( "," key )
+  using key = g::action<g::plus<g::alpha>, record>;
+  using list = g::seq<key, g::star<g::seq<g::ch<','>, key>>>;
+  std::vector<std::string> keys;
+  EXPECT_TRUE (g::full<list> ("a,bc,def", keys));
+  EXPECT_THAT (keys, ElementsAre ("a", "bc", "def"));
+}
+// NOLINTNEXTLINE
+TEST (Grammar, AsRule) {
+  std::string s;
+  bool const ok =
+    uri::rule ("http:")
+      .concat (g::as_rule<scheme>, [&s] (std::string_view str) { s = str; })
+      .concat (uri::colon)
+      .done ();
+  EXPECT_TRUE (ok);
+  EXPECT_EQ (s, "http");
+  EXPECT_FALSE (uri::rule ("1:").concat (g::as_rule<scheme>).done ());
+}
+// NOLINTNEXTLINE
+TEST (Grammar, NamedReportsFailure) {
+  std::string_view const in = "a%4";
+  uri::furthest_failure failure;
+  EXPECT_FALSE ((uri::rule{in, failure}
+                   .concat (g::as_rule<g::alpha>)
+                   .concat (g::as_rule<pct_encoded>)
+                   .done ()));
+  EXPECT_EQ (failure.position (), in.data () + 3);
+  ASSERT_NE (failure.production (), nullptr);
+  EXPECT_STREQ (failure.production (), "pct-encoded");
+}
+// NOLINTNEXTLINE
+TEST (Grammar, NamedIsTraced) {
+  uri::trace::reset ();
+  uri::trace::enable ();
+  EXPECT_TRUE (uri::rule ("%41").concat (g::as_rule<pct_encoded>).done ());
+  EXPECT_FALSE (uri::rule ("%4").concat (g::as_rule<pct_encoded>).done ());
+  uri::trace::enable (false);
+
+  auto const snapshot = uri::trace::snapshot ();
+  if constexpr (!uri::trace::available) {
+    EXPECT_TRUE (snapshot.empty ());
+  } else {
+    uri::trace::counters expected;
+    expected.attempts = 2;
+    expected.successes = 1;
+    expected.failures = 1;
+    expected.bytes = 3;
+    ASSERT_EQ (snapshot.size (), 1U);
+    EXPECT_EQ (snapshot[0].first, "pct-encoded");
+    EXPECT_EQ (snapshot[0].second, expected);
+  }
+  uri::trace::reset ();
+}
+
+#if URI_FUZZTEST
+static void SchemeMatchesRule (std::string const& s) {
+  auto const scheme_rule = [] (uri::rule const& r) {
+    return r.concat (uri::alpha)
+      .star ([] (uri::rule const& r2) {
+        return r2
+          .alternative (uri::alpha, uri::digit, uri::plus, uri::minus,
+                        uri::full_stop)
+          .matched ("scheme/*", r2);
+      })
+      .matched ("scheme", r);
+  };
+  EXPECT_EQ (g::full<scheme> (s), uri::rule{s}.concat (scheme_rule).done ());
+}
+FUZZ_TEST (Grammar, SchemeMatchesRule);
+#endif  // URI_FUZZTEST
@@ -19,7 +19,9 @@
 #endif
 
 #include <tuple>
+#include <vector>
 
+using namespace std::string_literals;
 using namespace std::string_view_literals;
 
 class UriPctDecode : public testing::TestWithParam<
@@ -43,6 +45,36 @@ TEST_P (UriPctDecode, RangeBasedForLoop) {
   EXPECT_EQ (out, expected);
 }
 
+// NOLINTNEXTLINE
+TEST_P (UriPctDecode, String) {
+  auto const& [input, expected] = GetParam ();
+  EXPECT_EQ (uri::pctdecode (input), expected);
+}
+
+// NOLINTNEXTLINE
+TEST_P (UriPctDecode, InPlace) {
+  auto const& [input, expected] = GetParam ();
+  std::string str{input};
+  EXPECT_EQ (uri::pctdecode_inplace (str), expected);
+
+  std::string buffer{input};
+  auto* const first = buffer.data ();
+  auto* const last = uri::pctdecode_inplace (first, first + buffer.length ());
+  EXPECT_EQ (std::string_view (first, static_cast<std::size_t> (last - first)),
+             expected);
+}
+
+// NOLINTNEXTLINE
+TEST_P (UriPctDecode, Chunks) {
+  auto const& [input, expected] = GetParam ();
+  std::string out;
+  for (std::string_view const chunk : uri::pctdecode_chunks{input}) {
+    EXPECT_FALSE (chunk.empty ());
+    out.append (chunk);
+  }
+  EXPECT_EQ (out, expected);
+}
+
 #if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
 // NOLINTNEXTLINE
 TEST_P (UriPctDecode, RangesCopy) {
@@ -77,7 +109,220 @@ INSTANTIATE_TEST_SUITE_P (
     std::make_tuple ("ab%1q"sv, "ab%1q"sv)   // percent then one hex
     ));
 
+// NOLINTNEXTLINE
+TEST (UriPctDecodeString, LongInputs) {
+  // Place escapes (valid and otherwise) on either side of the 16 byte blocks
+  // used by the vectorized search.
+  for (auto const* const escape : {"%41", "%4", "%", "%zz", "%%41"}) {
+    for (auto prefix = std::size_t{0}; prefix < 40; ++prefix) {
+      std::string const input =
+        std::string (prefix, 'x') + escape + std::string (prefix % 7, 'y');
+      std::string expected;
+      std::copy (uri::pctdecode_begin (input), uri::pctdecode_end (input),
+                 std::back_inserter (expected));
+      EXPECT_EQ (uri::pctdecode (input), expected) << "input=" << input;
+      std::string inplace = input;
+      EXPECT_EQ (uri::pctdecode_inplace (inplace), expected)
+        << "input=" << input;
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeChunks, Runs) {
+  using testing::ElementsAre;
+  auto const chunks = [] (std::string_view const s) {
+    uri::pctdecode_chunks const c{s};
+    return std::vector<std::string_view> (c.begin (), c.end ());
+  };
+  EXPECT_THAT (chunks (""sv), ElementsAre ());
+  EXPECT_THAT (chunks ("abc"sv), ElementsAre ("abc"sv));
+  EXPECT_THAT (chunks ("a%62%63def"sv),
+               ElementsAre ("a"sv, "b"sv, "c"sv, "def"sv));
+  EXPECT_THAT (chunks ("%00"sv), ElementsAre ("\0"sv));
+  EXPECT_THAT (chunks ("%FF"sv), ElementsAre ("\xFF"sv));
+  // Invalid escapes are part of the literal runs.
+  EXPECT_THAT (chunks ("%zz%%41%4"sv), ElementsAre ("%zz%"sv, "A"sv, "%4"sv));
+  // Literal runs refer to the input.
+  auto const input = "abc%20def"sv;
+  EXPECT_EQ (chunks (input).front ().data (), input.data ());
+#if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
+  static_assert (std::ranges::forward_range<uri::pctdecode_chunks>);
+  static_assert (std::ranges::borrowed_range<uri::pctdecode_chunks>);
+#endif  // __cpp_lib_ranges
+}
+
+namespace {
+
+/// Returns the error code and offset produced by pctdecode_strict() or
+/// pctdecode_error_code::none if it succeeded.
+std::tuple<std::error_code, std::size_t> strict_error (
+  std::string_view const s, uri::pctdecode_checks const checks = {}) {
+  auto const result = uri::pctdecode_strict (s, checks);
+  if (auto const* const err = std::get_if<uri::pctdecode_error> (&result)) {
+    return std::make_tuple (err->code, err->offset);
+  }
+  return std::make_tuple (make_error_code (uri::pctdecode_error_code::none),
+                          std::size_t{0});
+}
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeStrict, Valid) {
+  EXPECT_EQ (uri::pctdecode_strict (""sv), uri::pctdecode_strict_result{""});
+  EXPECT_EQ (uri::pctdecode_strict ("a%62%63def"sv),
+             uri::pctdecode_strict_result{"abcdef"});
+  EXPECT_EQ (uri::pctdecode_strict ("%7a%7A"sv),
+             uri::pctdecode_strict_result{"zz"});
+  // The optional checks don't reject good input.
+  EXPECT_EQ (uri::pctdecode_strict ("%C3%A9t%C3%A9"sv, {true, true}),
+             uri::pctdecode_strict_result{"\xC3\xA9t\xC3\xA9"});
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeStrict, BadEscapes) {
+  using uri::pctdecode_error_code;
+  auto const bad_escape = make_error_code (pctdecode_error_code::bad_escape);
+  auto const truncated =
+    make_error_code (pctdecode_error_code::truncated_escape);
+  EXPECT_EQ (strict_error ("ab%qq"sv), std::make_tuple (bad_escape, 2U));
+  EXPECT_EQ (strict_error ("ab%1q"sv), std::make_tuple (bad_escape, 2U));
+  EXPECT_EQ (strict_error ("%41%%41"sv), std::make_tuple (bad_escape, 3U));
+  EXPECT_EQ (strict_error ("ab%q"sv), std::make_tuple (bad_escape, 2U));
+  EXPECT_EQ (strict_error ("ab%"sv), std::make_tuple (truncated, 2U));
+  EXPECT_EQ (strict_error ("ab%4"sv), std::make_tuple (truncated, 2U));
+  // Only the first error is reported.
+  EXPECT_EQ (strict_error ("%zz%4"sv), std::make_tuple (bad_escape, 0U));
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeStrict, Nul) {
+  auto const nul = make_error_code (uri::pctdecode_error_code::nul);
+  uri::pctdecode_checks checks;
+  checks.nul = true;
+  EXPECT_EQ (strict_error ("ab%00"sv, checks), std::make_tuple (nul, 2U));
+  EXPECT_EQ (strict_error ("abc\0"sv, checks), std::make_tuple (nul, 3U));
+  // NUL is allowed unless the check is requested.
+  EXPECT_EQ (uri::pctdecode_strict ("a%00"sv),
+             uri::pctdecode_strict_result{"a\0"s});
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeStrict, Utf8) {
+  auto const bad_utf8 = make_error_code (uri::pctdecode_error_code::bad_utf8);
+  uri::pctdecode_checks checks;
+  checks.utf8 = true;
+  // A lone continuation byte.
+  EXPECT_EQ (strict_error ("ab%80"sv, checks), std::make_tuple (bad_utf8, 2U));
+  // An overlong encoding of '/'.
+  EXPECT_EQ (strict_error ("a%C0%AF"sv, checks),
+             std::make_tuple (bad_utf8, 1U));
+  // A surrogate.
+  EXPECT_EQ (strict_error ("a%ED%A0%80"sv, checks),
+             std::make_tuple (bad_utf8, 1U));
+  // A truncated sequence: reported at its first byte.
+  EXPECT_EQ (strict_error ("a%E2%82"sv, checks),
+             std::make_tuple (bad_utf8, 1U));
+  EXPECT_EQ (strict_error ("a%E2%82b"sv, checks),
+             std::make_tuple (bad_utf8, 1U));
+  // Literal and escaped bytes may be mixed within a sequence.
+  EXPECT_EQ (uri::pctdecode_strict ("\xE2%82\xAC"sv, checks),
+             uri::pctdecode_strict_result{"\xE2\x82\xAC"});
+  EXPECT_EQ (strict_error ("0123456789abcdef0123\xFF"sv, checks),
+             std::make_tuple (bad_utf8, 20U));
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeStrict, LongInputs) {
+  auto const bad_escape =
+    make_error_code (uri::pctdecode_error_code::bad_escape);
+  for (auto prefix = std::size_t{0}; prefix < 40; ++prefix) {
+    std::string const good = std::string (prefix, 'x') + "%41" +
+                             std::string (prefix % 7, 'y');
+    EXPECT_EQ (uri::pctdecode_strict (good, {true, true}),
+               uri::pctdecode_strict_result{uri::pctdecode (good)})
+      << "input=" << good;
+    std::string const bad = std::string (prefix, 'x') + "%zz";
+    EXPECT_EQ (strict_error (bad, {true, true}),
+               std::make_tuple (bad_escape, prefix))
+      << "input=" << bad;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeUtf8, Valid) {
+  EXPECT_EQ (uri::pctdecode_utf8 (""sv), uri::pctdecode_strict_result{""});
+  EXPECT_EQ (uri::pctdecode_utf8 ("caf%C3%A9"sv),
+             uri::pctdecode_strict_result{"caf\xC3\xA9"});
+  // Invalid escapes are passed through as they are by pctdecode().
+  EXPECT_EQ (uri::pctdecode_utf8 ("%zz%4"sv),
+             uri::pctdecode_strict_result{"%zz%4"});
+  // Four byte sequences, mixing literal and escaped bytes.
+  EXPECT_EQ (uri::pctdecode_utf8 ("%F0\x9F%98\x80"sv),
+             uri::pctdecode_strict_result{"\xF0\x9F\x98\x80"});
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeUtf8, Invalid) {
+  auto const bad_utf8 = make_error_code (uri::pctdecode_error_code::bad_utf8);
+  auto const error = [&bad_utf8] (std::size_t offset) {
+    return uri::pctdecode_strict_result{uri::pctdecode_error{bad_utf8, offset}};
+  };
+  EXPECT_EQ (uri::pctdecode_utf8 ("ab%80"sv), error (2));
+  EXPECT_EQ (uri::pctdecode_utf8 ("a%C0%AF"sv), error (1));
+  EXPECT_EQ (uri::pctdecode_utf8 ("a%ED%A0%80"sv), error (1));
+  EXPECT_EQ (uri::pctdecode_utf8 ("a%F4%90%80%80"sv), error (1));
+  EXPECT_EQ (uri::pctdecode_utf8 ("a%E2%82"sv), error (1));
+  EXPECT_EQ (uri::pctdecode_utf8 ("a%E2%82b"sv), error (1));
+  EXPECT_EQ (uri::pctdecode_utf8 ("a\xFF"sv), error (1));
+}
+
+// NOLINTNEXTLINE
+TEST (UriPctDecodeUtf8, LongInputs) {
+  // A mixture of literal and escaped multi-byte sequences which is long
+  // enough to cover many blocks of the vectorized validator as well as
+  // the chunks in which the input is decoded.
+  std::string good;
+  while (good.length () < 9000) {
+    good += "p\xC3\xA9r%C3%A9%E2%82%AC\xE2\x82\xAC%F0%9F%98%80/";
+  }
+  uri::pctdecode_checks checks;
+  checks.utf8 = true;
+  auto const expected = uri::pctdecode_strict (good, checks);
+  ASSERT_TRUE (std::holds_alternative<std::string> (expected));
+  EXPECT_EQ (uri::pctdecode_utf8 (good), expected);
+
+  // Now damage the input at a variety of positions. The result should always
+  // match that of the scalar validator used by pctdecode_strict().
+  for (auto pos = std::size_t{0}; pos < good.length (); pos += 37) {
+    for (auto const* const damage : {"\xFF", "%80", "\xE2", "%F0%9F"}) {
+      std::string bad = good;
+      bad.insert (pos, damage);
+      if (!std::holds_alternative<std::string> (uri::pctdecode_strict (bad))) {
+        continue;  // The insertion damaged an escape.
+      }
+      EXPECT_EQ (uri::pctdecode_utf8 (bad), uri::pctdecode_strict (bad, checks))
+        << "pos=" << pos << " damage=" << damage;
+    }
+  }
+}
+
 #if URI_FUZZTEST
+static void PctDecodeStringMatchesIterator (std::string const& input) {
+  std::string expected;
+  std::copy (uri::pctdecode_begin (input), uri::pctdecode_end (input),
+             std::back_inserter (expected));
+  EXPECT_EQ (uri::pctdecode (input), expected);
+}
+FUZZ_TEST (PctDecodeFuzz, PctDecodeStringMatchesIterator);
+
+static void PctDecodeInPlaceMatchesString (std::string const& input) {
+  std::string inplace = input;
+  EXPECT_EQ (uri::pctdecode_inplace (inplace), uri::pctdecode (input));
+}
+FUZZ_TEST (PctDecodeFuzz, PctDecodeInPlaceMatchesString);
+
 static void PctDecodeNeverCrashes (std::string const& input) {
   std::string out;
   std::copy (uri::pctdecode_begin (input), uri::pctdecode_end (input),
@@ -85,6 +330,36 @@ static void PctDecodeNeverCrashes (std::string const& input) {
 }
 FUZZ_TEST (PctDecodeFuzz, PctDecodeNeverCrashes);
 
+static void PctDecodeStrictMatchesString (std::string const& input) {
+  // If strict decoding succeeds, it must agree with the lenient decoder.
+  auto const result = uri::pctdecode_strict (input);
+  if (auto const* const str = std::get_if<std::string> (&result)) {
+    EXPECT_EQ (*str, uri::pctdecode (input));
+  }
+}
+FUZZ_TEST (PctDecodeFuzz, PctDecodeStrictMatchesString);
+
+static void PctDecodeChunksMatchesString (std::string const& input) {
+  std::string out;
+  for (std::string_view const chunk : uri::pctdecode_chunks{input}) {
+    out.append (chunk);
+  }
+  EXPECT_EQ (out, uri::pctdecode (input));
+}
+FUZZ_TEST (PctDecodeFuzz, PctDecodeChunksMatchesString);
+
+static void PctDecodeUtf8MatchesStrict (std::string const& input) {
+  // Where the input contains no bad escapes, the fused decoder and the strict
+  // decoder should agree on the result and the position of any error.
+  if (std::holds_alternative<std::string> (uri::pctdecode_strict (input))) {
+    uri::pctdecode_checks checks;
+    checks.utf8 = true;
+    EXPECT_EQ (uri::pctdecode_utf8 (input),
+               uri::pctdecode_strict (input, checks));
+  }
+}
+FUZZ_TEST (PctDecodeFuzz, PctDecodeUtf8MatchesStrict);
+
 #if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
 static void PctDecodeViewNeverCrashes (std::string const& input) {
   std::string out;
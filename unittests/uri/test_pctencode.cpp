@@ -13,6 +13,8 @@
 #include "uri/pctdecode.hpp"
 #include "uri/pctencode.hpp"
 
+#include <algorithm>
+#include <array>
 #include <iterator>
 #include <limits>
 #include <numeric>
@@ -123,6 +125,154 @@ TEST (PctEncode, CodePointNeedsEncodeExhaustive) {
   }
 }
 
+namespace {
+
+constexpr std::array<uri::pctencode_set, 7> all_encode_sets{{
+  uri::pctencode_set::fragment,
+  uri::pctencode_set::query,
+  uri::pctencode_set::special_query,
+  uri::pctencode_set::path,
+  uri::pctencode_set::userinfo,
+  uri::pctencode_set::component,
+  uri::pctencode_set::form_urlencoded,
+}};
+
+std::string pctencode_with_output_iterator (std::string_view s,
+                                            uri::pctencode_set encodeset) {
+  std::string out;
+  uri::pctencode (std::begin (s), std::end (s), std::back_inserter (out),
+                  encodeset);
+  return out;
+}
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST (PctEncode, EncodedLength) {
+  EXPECT_EQ (uri::pctencoded_length ("", uri::pctencode_set::path), 0U);
+  EXPECT_EQ (uri::pctencoded_length ("abc", uri::pctencode_set::path), 3U);
+  EXPECT_EQ (uri::pctencoded_length ("a b", uri::pctencode_set::path), 5U);
+  // Every code unit of a long string needs to be encoded.
+  std::string const spaces (100, ' ');
+  EXPECT_EQ (uri::pctencoded_length (spaces, uri::pctencode_set::fragment),
+             300U);
+  EXPECT_EQ (uri::pctencode (spaces, uri::pctencode_set::fragment).length (),
+             300U);
+}
+
+// NOLINTNEXTLINE
+TEST (PctEncode, CompileTimeEncodeSet) {
+  auto input = "/a b?c"sv;
+  std::string out;
+  uri::pctencode<uri::pctencode_set::path> (
+    std::begin (input), std::end (input), std::back_inserter (out));
+  EXPECT_EQ (out, "/a%20b%3Fc");
+  static_assert (uri::needs_pctencode<uri::pctencode_set::path> ('?'));
+  static_assert (!uri::needs_pctencode<uri::pctencode_set::query> ('?'));
+}
+
+// NOLINTNEXTLINE
+TEST (PctEncode, TablesMatchRuntimeSet) {
+  for (auto c = 0U; c < 256U; ++c) {
+    auto const cu = static_cast<std::uint_least8_t> (c);
+    using uri::pctencode_set;
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::none> (cu),
+               uri::needs_pctencode (cu, pctencode_set::none));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::fragment> (cu),
+               uri::needs_pctencode (cu, pctencode_set::fragment));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::query> (cu),
+               uri::needs_pctencode (cu, pctencode_set::query));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::special_query> (cu),
+               uri::needs_pctencode (cu, pctencode_set::special_query));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::path> (cu),
+               uri::needs_pctencode (cu, pctencode_set::path));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::userinfo> (cu),
+               uri::needs_pctencode (cu, pctencode_set::userinfo));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::component> (cu),
+               uri::needs_pctencode (cu, pctencode_set::component));
+    EXPECT_EQ (uri::needs_pctencode<pctencode_set::form_urlencoded> (cu),
+               uri::needs_pctencode (cu, pctencode_set::form_urlencoded));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST (PctEncode, StringMatchesIterator) {
+  // Place every code unit at each position of a string long enough to span
+  // several of the blocks used by the vectorized classifier.
+  for (auto const es : all_encode_sets) {
+    for (auto c = 0U; c < 256U; ++c) {
+      for (auto pos = std::size_t{0}; pos < 40; pos += 13) {
+        std::string input (40, 'a');
+        input[pos] = static_cast<char> (c);
+        auto const expected = pctencode_with_output_iterator (input, es);
+        EXPECT_EQ (uri::pctencode (input, es), expected)
+          << "code unit=" << c << " pos=" << pos;
+        EXPECT_EQ (uri::needs_pctencode (input, es), expected != input)
+          << "code unit=" << c << " pos=" << pos;
+        EXPECT_EQ (uri::pctencoded_length (input, es), expected.length ())
+          << "code unit=" << c << " pos=" << pos;
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST (PctEncode, LazyIterator) {
+  auto const input = "/a b?c%\xC3\xA9"sv;
+  auto const es = uri::pctencode_set::path;
+  std::string out (uri::pctencode_begin (input, es),
+                   uri::pctencode_end (input, es));
+  EXPECT_EQ (out, "/a%20b%3Fc%25%C3%A9");
+
+  // Every code unit in every encode set.
+  std::string all;
+  for (auto c = 0U; c < 256U; ++c) {
+    all += static_cast<char> (c);
+  }
+  for (auto const es2 : all_encode_sets) {
+    std::string lazy (uri::pctencode_begin (all, es2),
+                      uri::pctencode_end (all, es2));
+    EXPECT_EQ (lazy, uri::pctencode (all, es2));
+  }
+}
+
+#if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
+// NOLINTNEXTLINE
+TEST (PctEncode, View) {
+  auto const input = "a b&c"sv;
+  std::string out;
+  std::ranges::copy (input | uri::views::pctencode (uri::pctencode_set::query),
+                     std::back_inserter (out));
+  EXPECT_EQ (out, "a%20b&c");
+  out.clear ();
+  std::ranges::copy (
+    uri::views::pctencode (input, uri::pctencode_set::form_urlencoded),
+    std::back_inserter (out));
+  EXPECT_EQ (out, "a%20b%26c");
+
+  auto const v = input | uri::views::pctencode (uri::pctencode_set::query);
+  static_assert (std::ranges::forward_range<decltype (v)>);
+  EXPECT_EQ (std::ranges::distance (v), 7);
+
+  // A view whose end is not an iterator.
+  auto const until_nul =
+    std::views::take_while ("a b\0c"sv, [] (char c) { return c != '\0'; });
+  out.clear ();
+  std::ranges::copy (
+    until_nul | uri::views::pctencode (uri::pctencode_set::path),
+    std::back_inserter (out));
+  EXPECT_EQ (out, "a%20b");
+}
+#endif  // __cpp_lib_ranges
+
+#if URI_FUZZTEST
+static void EncodeStringMatchesIterator (std::string const& s,
+                                         uri::pctencode_set encodeset) {
+  EXPECT_EQ (uri::pctencode (s, encodeset),
+             pctencode_with_output_iterator (s, encodeset));
+}
+#endif  // URI_FUZZTEST
+
 #if URI_FUZZTEST
 static void EncodeNeverCrashes (std::string const& s,
                                 uri::pctencode_set encodeset) {
@@ -139,6 +289,17 @@ static auto AnyEncodeSet () {
 }
 FUZZ_TEST (PctEncodeFuzz, EncodeNeverCrashes)
   .WithDomains (fuzztest::String (), AnyEncodeSet ());
+FUZZ_TEST (PctEncodeFuzz, EncodeStringMatchesIterator)
+  .WithDomains (fuzztest::String (), AnyEncodeSet ());
+
+static void EncodeLazyMatchesString (std::string const& s,
+                                     uri::pctencode_set encodeset) {
+  EXPECT_EQ (std::string (uri::pctencode_begin (s, encodeset),
+                          uri::pctencode_end (s, encodeset)),
+             uri::pctencode (s, encodeset));
+}
+FUZZ_TEST (PctEncodeFuzz, EncodeLazyMatchesString)
+  .WithDomains (fuzztest::String (), AnyEncodeSet ());
 #endif  // URI_FUZZTEST
 
 #if URI_FUZZTEST
@@ -13,6 +13,9 @@
 #include "gtest/gtest.h"
 #include "uri/punycode.hpp"
 
+#include <array>
+#include <string>
+
 #if URI_FUZZTEST
 #include "fuzztest/fuzztest.h"
 #endif
@@ -298,6 +301,217 @@ TEST (Punycode, ExampleS) {
              uri::punycode::decode_result{orig});
 }
 
+// NOLINTNEXTLINE
+TEST (Punycode, RepeatedCodePoints) {
+  auto const orig = std::u32string{0x4E2D, 0x0061, 0x6587, 0x4E2D,
+                                   0x0062, 0x4E2D, 0x6587};
+  std::string encoded;
+  uri::punycode::encode (orig, std::back_inserter (encoded));
+  EXPECT_EQ (encoded, "ab-py2cbb9796ada");
+  EXPECT_EQ (uri::punycode::decode (encoded),
+             uri::punycode::decode_result{orig});
+}
+
+// NOLINTNEXTLINE
+TEST (Punycode, LongInput) {
+  // Longer than the limit for inline storage in encode().
+  std::u32string orig;
+  for (auto ctr = char32_t{0};
+       orig.size () <= uri::punycode::max_inline_label * 3U; ++ctr) {
+    orig += (ctr % 5U == 0U) ? static_cast<char32_t> ('a' + ctr % 26U)
+                             : static_cast<char32_t> (0x4E00 + ctr % 37U);
+  }
+  std::string encoded;
+  uri::punycode::encode (orig, std::back_inserter (encoded));
+  EXPECT_EQ (uri::punycode::decode (encoded),
+             uri::punycode::decode_result{orig});
+}
+
+// NOLINTNEXTLINE
+TEST (Punycode, DecodeToBuffer) {
+  // Chinese (simplified)
+  auto const* const encoded = "ihqwcrb4cv8a8dqg056pqjye";
+  std::array<char32_t, 16> buffer{};
+  auto const r = uri::punycode::decode (encoded, buffer.data (),
+                                        buffer.data () + buffer.size ());
+  ASSERT_TRUE (std::holds_alternative<char32_t*> (r));
+  auto* const end = std::get<char32_t*> (r);
+  EXPECT_EQ (std::u32string (buffer.data (), end),
+             std::get<std::u32string> (uri::punycode::decode (encoded)));
+
+  // A buffer which is too small.
+  auto const small = uri::punycode::decode (encoded, buffer.data (),
+                                            buffer.data () + 4);
+  EXPECT_EQ (small, (std::variant<std::error_code, char32_t*>{make_error_code (
+                      uri::punycode::decode_error_code::too_long)}));
+}
+
+// NOLINTNEXTLINE
+TEST (Punycode, DecodeToIterator) {
+  std::u32string out;
+  auto const r = uri::punycode::decode (",--9cr", std::back_inserter (out));
+  EXPECT_EQ (r.index (), 1U);
+  EXPECT_EQ (out, (std::u32string{0x002C, 0x002D, 0x1BC0}));
+
+  // A truncated variable-length integer.
+  auto const bad = uri::punycode::decode ("9", std::back_inserter (out));
+  ASSERT_EQ (bad.index (), 0U);
+  EXPECT_EQ (std::get<std::error_code> (bad),
+             make_error_code (uri::punycode::decode_error_code::bad_input));
+}
+
+// NOLINTNEXTLINE
+TEST (Punycode, DecodeUtf8) {
+  std::string out;
+  // "bücher"
+  auto const r =
+    uri::punycode::decode_utf8 ("bcher-kva", std::back_inserter (out));
+  EXPECT_EQ (r.index (), 1U);
+  EXPECT_EQ (out, "b\xC3\xBC" "cher");
+
+  // Code points from each of the UTF-8 sequence lengths.
+  auto const orig = std::u32string{0x0041, 0x00E9, 0x4E2D, 0x1F600};
+  std::string encoded;
+  uri::punycode::encode (orig, std::back_inserter (encoded));
+  out.clear ();
+  EXPECT_EQ (uri::punycode::decode_utf8 (encoded, std::back_inserter (out))
+               .index (),
+             1U);
+  EXPECT_EQ (out, "A\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80");
+
+  // A surrogate cannot be represented in UTF-8.
+  encoded.clear ();
+  uri::punycode::encode (std::u32string{0xD800}, std::back_inserter (encoded));
+  auto const bad =
+    uri::punycode::decode_utf8 (encoded, std::back_inserter (out));
+  ASSERT_EQ (bad.index (), 0U);
+  EXPECT_EQ (std::get<std::error_code> (bad),
+             make_error_code (uri::punycode::decode_error_code::bad_input));
+}
+// NOLINTNEXTLINE
+TEST (Punycode, DecodeUtf8ToBuffer) {
+  // "bücher" has six code points so needs a buffer of 24 bytes.
+  std::array<char, 24> buffer{};
+  auto const r = uri::punycode::decode_utf8 (
+    "bcher-kva", buffer.data (), buffer.data () + buffer.size ());
+  ASSERT_EQ (r.index (), 1U);
+  EXPECT_EQ (std::string_view (buffer.data (),
+                               static_cast<std::size_t> (
+                                 std::get<char*> (r) - buffer.data ())),
+             "b\xC3\xBC" "cher");
+
+  auto const small = uri::punycode::decode_utf8 (
+    "bcher-kva", buffer.data (), buffer.data () + buffer.size () - 1U);
+  ASSERT_EQ (small.index (), 0U);
+  EXPECT_EQ (std::get<std::error_code> (small),
+             make_error_code (uri::punycode::decode_error_code::too_long));
+}
+
+// NOLINTNEXTLINE
+TEST (Punycode, EncodeUtf8) {
+  std::string out = "prefix:";
+  EXPECT_EQ (uri::punycode::encode ("b\xC3\xBC"
+                                    "cher",
+                                    out),
+             std::error_code{});
+  EXPECT_EQ (out, "prefix:bcher-kva");
+
+  // Invalid UTF-8: a truncated sequence, a surrogate, and an overlong form.
+  for (std::string_view const bad :
+       {"b\xC3", "\xED\xA0\x80", "\xC0\xAF", "abc\x80"}) {
+    out.clear ();
+    EXPECT_EQ (uri::punycode::encode (bad, out),
+               make_error_code (uri::punycode::decode_error_code::bad_input));
+  }
+}
+// NOLINTNEXTLINE
+TEST (Punycode, DecodeUtf8ToString) {
+  std::string out = "prefix:";
+  EXPECT_EQ (uri::punycode::decode ("bcher-kva", out), std::error_code{});
+  EXPECT_EQ (out, "prefix:b\xC3\xBC" "cher");
+
+  out.clear ();
+  EXPECT_EQ (uri::punycode::decode ("9", out),
+             make_error_code (uri::punycode::decode_error_code::bad_input));
+}
+// NOLINTNEXTLINE
+TEST (Punycode, Utf8RoundTripLong) {
+  // Long inputs which mix runs of ASCII with multi-byte sequences exercise
+  // the block-at-a-time transcoding paths.
+  std::string orig;
+  std::u32string code_points;
+  for (auto ctr = 0; ctr < 40; ++ctr) {
+    orig += "abcdefghijklmnopqrstu";
+    orig += "\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80";
+    code_points += U"abcdefghijklmnopqrstu";
+    code_points += std::u32string{0x00E9, 0x4E2D, 0x1F600};
+  }
+  std::string encoded;
+  ASSERT_EQ (uri::punycode::encode (orig, encoded), std::error_code{});
+
+  std::string expected;
+  uri::punycode::encode (code_points, std::back_inserter (expected));
+  EXPECT_EQ (encoded, expected);
+
+  std::string decoded;
+  ASSERT_EQ (uri::punycode::decode (encoded, decoded), std::error_code{});
+  EXPECT_EQ (decoded, orig);
+}
+
+// NOLINTNEXTLINE
+TEST (Punycode, ToAsciiUnchanged) {
+  std::string buffer;
+  for (std::string_view const host : {"", "example.com", "www.example.com.",
+                                      "xn--bcher-kva.example", "a..b"}) {
+    auto const r = uri::punycode::to_ascii (host, buffer);
+    ASSERT_EQ (r.index (), 1U) << "host: " << host;
+    auto const actual = std::get<std::string_view> (r);
+    EXPECT_EQ (actual.data (), host.data ())
+      << "An unchanged host should not be copied";
+    EXPECT_EQ (actual, host);
+  }
+  EXPECT_TRUE (buffer.empty ());
+}
+// NOLINTNEXTLINE
+TEST (Punycode, ToAscii) {
+  std::string buffer;
+  auto const to_ascii = [&buffer] (std::string_view const host) {
+    auto const r = uri::punycode::to_ascii (host, buffer);
+    return r.index () == 1U ? std::string{std::get<std::string_view> (r)}
+                            : std::string{"error"};
+  };
+  EXPECT_EQ (to_ascii ("b\xC3\xBC" "cher.example"), "xn--bcher-kva.example");
+  EXPECT_EQ (to_ascii ("www.b\xC3\xBC" "cher.example."),
+             "www.xn--bcher-kva.example.");
+  EXPECT_EQ (to_ascii ("\xE4\xB8\xAD\xE6\x96\x87.xn--bcher-kva"),
+             "xn--fiq228c.xn--bcher-kva");
+  // Invalid UTF-8.
+  EXPECT_EQ (to_ascii ("b\xC3" "cher.example"), "error");
+  EXPECT_EQ (to_ascii ("\xFF.example"), "error");
+  // A label with the ACE prefix must be valid punycode.
+  EXPECT_EQ (to_ascii ("xn--9.example"), "error");
+  EXPECT_EQ (to_ascii ("XN--9.b\xC3\xBC" "cher"), "error");
+}
+// NOLINTNEXTLINE
+TEST (Punycode, ToUnicode) {
+  std::string buffer;
+  auto const unchanged = std::string_view{"www.example.com"};
+  auto const r1 = uri::punycode::to_unicode (unchanged, buffer);
+  ASSERT_EQ (r1.index (), 1U);
+  EXPECT_EQ (std::get<std::string_view> (r1).data (), unchanged.data ());
+
+  auto const r2 =
+    uri::punycode::to_unicode ("www.xn--bcher-kva.XN--fiq228c.", buffer);
+  ASSERT_EQ (r2.index (), 1U);
+  EXPECT_EQ (std::get<std::string_view> (r2),
+             "www.b\xC3\xBC" "cher.\xE4\xB8\xAD\xE6\x96\x87.");
+
+  auto const r3 = uri::punycode::to_unicode ("xn--9.example", buffer);
+  ASSERT_EQ (r3.index (), 0U);
+  EXPECT_EQ (std::get<std::error_code> (r3),
+             make_error_code (uri::punycode::decode_error_code::bad_input));
+}
+
 #if URI_FUZZTEST
 static void EncodeNeverCrashes (std::u32string const& s) {
   std::string actual;
@@ -325,4 +539,51 @@ static void RoundTrip (std::u32string const& s) {
   EXPECT_EQ (uri::punycode::decode (encoded), uri::punycode::decode_result{s});
 }
 FUZZ_TEST (Punycode, RoundTrip).WithDomains (U32String ());
+
+static void HostRoundTrip (std::string const& host) {
+  std::string ascii_buffer;
+  auto const ascii = uri::punycode::to_ascii (host, ascii_buffer);
+  if (auto const* const a = std::get_if<std::string_view> (&ascii)) {
+    std::string unicode_buffer;
+    auto const unicode = uri::punycode::to_unicode (*a, unicode_buffer);
+    EXPECT_EQ (unicode.index (), 1U)
+      << "The output of to_ascii() should always be valid input to "
+         "to_unicode()";
+  }
+}
+FUZZ_TEST (Punycode, HostRoundTrip);
+
+static void Utf8MatchesUtf32 (std::u32string const& s) {
+  std::string utf8;
+  auto const r = uri::punycode::decode_utf8 (
+    [&s] {
+      std::string encoded;
+      uri::punycode::encode (s, std::back_inserter (encoded));
+      return encoded;
+    }(),
+    std::back_inserter (utf8));
+  if (r.index () == 0U) {
+    return;  // Not all code points can be represented in UTF-8.
+  }
+  std::string expected;
+  uri::punycode::encode (s, std::back_inserter (expected));
+  std::string actual;
+  ASSERT_EQ (uri::punycode::encode (utf8, actual), std::error_code{});
+  EXPECT_EQ (actual, expected);
+  std::string decoded;
+  ASSERT_EQ (uri::punycode::decode (actual, decoded), std::error_code{});
+  EXPECT_EQ (decoded, utf8);
+}
+FUZZ_TEST (Punycode, Utf8MatchesUtf32).WithDomains (U32String ());
+
+static void DecodeIteratorMatchesString (std::string const& s) {
+  std::u32string out;
+  auto const r = uri::punycode::decode (s, std::back_inserter (out));
+  auto const expected = uri::punycode::decode (s);
+  ASSERT_EQ (r.index (), expected.index ());
+  if (auto const* const str = std::get_if<std::u32string> (&expected)) {
+    EXPECT_EQ (out, *str);
+  }
+}
+FUZZ_TEST (Punycode, DecodeIteratorMatchesString);
 #endif  // URI_FUZZTEST
@@ -0,0 +1,180 @@
+//===- unittests/uri/test_punycode_cache.cpp ------------------------------===//
+//*                                        _                        _          *
+//*  _ __  _   _ _ __  _   _  ___ ___   __| | ___     ___ __ _  ___| |__   ___ *
+//* | '_ \| | | | '_ \| | | |/ __/ _ \ / _` |/ _ \   / __/ _` |/ __| '_ \ / _ \*
+//* | |_) | |_| | | | | |_| | (_| (_) | (_| |  __/  | (_| (_| | (__| | | |  __/*
+//* | .__/ \__,_|_| |_|\__, |\___\___/ \__,_|\___|___\___\__,_|\___|_| |_|\___|*
+//* |_|                |___/                    |_____|                        *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/punycode_cache.hpp"
+
+// google test/fuzz.
+#include "gtest/gtest.h"
+#if URI_FUZZTEST
+#include "fuzztest/fuzztest.h"
+#endif
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "uri/punycode.hpp"
+
+// NOLINTNEXTLINE
+TEST (PunycodeCache, HitsAndMisses) {
+  uri::punycode::cache cache;
+  std::string out;
+  EXPECT_EQ (cache.decode ("bcher-kva", out), std::error_code{});
+  EXPECT_EQ (out, "b\xC3\xBC"
+                  "cher");
+  out.clear ();
+  EXPECT_EQ (cache.decode ("bcher-kva", out), std::error_code{});
+  EXPECT_EQ (out, "b\xC3\xBC"
+                  "cher");
+
+  // Encoding the same string is a different entry.
+  out = "prefix:";
+  EXPECT_EQ (cache.encode ("bcher-kva", out), std::error_code{});
+  EXPECT_EQ (out, "prefix:bcher-kva-");
+
+  auto const stats = cache.statistics ();
+  EXPECT_EQ (stats.hits, 1U);
+  EXPECT_EQ (stats.misses, 2U);
+  EXPECT_EQ (stats.evictions, 0U);
+  EXPECT_EQ (stats.entries, 2U);
+
+  cache.clear ();
+  auto const cleared = cache.statistics ();
+  EXPECT_EQ (cleared.hits, 0U);
+  EXPECT_EQ (cleared.misses, 0U);
+  EXPECT_EQ (cleared.entries, 0U);
+}
+// NOLINTNEXTLINE
+TEST (PunycodeCache, ErrorsAreNotCached) {
+  uri::punycode::cache cache;
+  std::string out;
+  auto const bad_input =
+    make_error_code (uri::punycode::decode_error_code::bad_input);
+  EXPECT_EQ (cache.decode ("9", out), bad_input);
+  EXPECT_EQ (cache.decode ("9", out), bad_input);
+  EXPECT_EQ (cache.encode ("\xFF", out), bad_input);
+  auto const stats = cache.statistics ();
+  EXPECT_EQ (stats.hits, 0U);
+  EXPECT_EQ (stats.misses, 3U);
+  EXPECT_EQ (stats.entries, 0U);
+}
+// NOLINTNEXTLINE
+TEST (PunycodeCache, LargeEntriesAreNotCached) {
+  uri::punycode::cache cache;
+  std::string const label (uri::punycode::cache::slot_size, 'a');
+  std::string out;
+  EXPECT_EQ (cache.encode (label, out), std::error_code{});
+  EXPECT_EQ (out, label + '-');
+  EXPECT_EQ (cache.statistics ().entries, 0U);
+}
+// NOLINTNEXTLINE
+TEST (PunycodeCache, LongLabelIsCached) {
+  // 52 CJK ideographs whose ACE form, with the "xn--" prefix, is a 63
+  // character label. The UTF-8 form is 156 bytes.
+  std::string label;
+  for (auto ctr = 0; ctr < 52; ++ctr) {
+    label += ctr % 2 == 0 ? "\xE6\x96\x87" : "\xE4\xB8\xAD";
+  }
+  uri::punycode::cache cache;
+  std::string encoded;
+  EXPECT_EQ (cache.encode (label, encoded), std::error_code{});
+  EXPECT_EQ (encoded.size (), uri::punycode::cache::max_label - 4U);
+  for (auto pass = 0; pass < 2; ++pass) {
+    std::string decoded;
+    EXPECT_EQ (cache.decode (encoded, decoded), std::error_code{});
+    EXPECT_EQ (decoded, label);
+  }
+  auto const stats = cache.statistics ();
+  EXPECT_EQ (stats.hits, 1U);
+  EXPECT_EQ (stats.entries, 2U);
+}
+// NOLINTNEXTLINE
+TEST (PunycodeCache, ShardsAreLimitedByBudget) {
+  // A zero budget allows a single entry and hence a single shard however
+  // many are requested.
+  uri::punycode::cache cache{0, 0x80000001U};
+  std::string out;
+  EXPECT_EQ (cache.encode ("a", out), std::error_code{});
+  EXPECT_EQ (cache.encode ("b", out), std::error_code{});
+  EXPECT_EQ (cache.encode ("c", out), std::error_code{});
+  EXPECT_EQ (out, "a-b-c-");
+  auto const stats = cache.statistics ();
+  EXPECT_EQ (stats.evictions, 2U);
+  EXPECT_EQ (stats.entries, 1U);
+}
+// NOLINTNEXTLINE
+TEST (PunycodeCache, LeastRecentlyUsedIsEvicted) {
+  // A budget so small that the cache holds a single entry.
+  uri::punycode::cache cache{0, 1};
+  std::string out;
+  EXPECT_EQ (cache.encode ("a", out), std::error_code{});
+  EXPECT_EQ (cache.encode ("b", out), std::error_code{});
+  EXPECT_EQ (cache.encode ("a", out), std::error_code{});
+  EXPECT_EQ (out, "a-b-a-");
+  auto const stats = cache.statistics ();
+  EXPECT_EQ (stats.hits, 0U);
+  EXPECT_EQ (stats.misses, 3U);
+  EXPECT_EQ (stats.evictions, 2U);
+  EXPECT_EQ (stats.entries, 1U);
+}
+// NOLINTNEXTLINE
+TEST (PunycodeCache, Threads) {
+  uri::punycode::cache cache{4096, 4};
+  std::vector<std::string> labels;
+  for (auto ctr = 0; ctr < 100; ++ctr) {
+    labels.push_back ("b\xC3\xBC" + std::to_string (ctr));
+  }
+  std::vector<std::thread> threads;
+  std::vector<int> failures (4, 0);
+  for (auto t = std::size_t{0}; t < failures.size (); ++t) {
+    threads.emplace_back ([&cache, &labels, &failure = failures[t]] {
+      for (auto pass = 0; pass < 10; ++pass) {
+        for (auto const& label : labels) {
+          std::string encoded;
+          std::string expected;
+          if (cache.encode (label, encoded) ||
+              uri::punycode::encode (label, expected) || encoded != expected) {
+            ++failure;
+          }
+          std::string decoded;
+          if (cache.decode (encoded, decoded) || decoded != label) {
+            ++failure;
+          }
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join ();
+  }
+  for (auto const failure : failures) {
+    EXPECT_EQ (failure, 0);
+  }
+  auto const stats = cache.statistics ();
+  EXPECT_EQ (stats.hits + stats.misses, 2U * 10U * 100U * failures.size ());
+}
+
+#if URI_FUZZTEST
+static void CacheMatchesDecode (std::vector<std::string> const& inputs) {
+  uri::punycode::cache cache{1024, 2};
+  for (auto pass = 0; pass < 2; ++pass) {
+    for (auto const& input : inputs) {
+      std::string actual;
+      std::string expected;
+      EXPECT_EQ (cache.decode (input, actual),
+                 uri::punycode::decode (input, expected));
+      EXPECT_EQ (actual, expected);
+    }
+  }
+}
+FUZZ_TEST (PunycodeCache, CacheMatchesDecode);
+#endif  // URI_FUZZTEST
@@ -0,0 +1,257 @@
+//===- unittests/uri/test_query.cpp ---------------------------------------===//
+//*  _           _                                   *
+//* | |_ ___ ___| |_     __ _ _   _  ___ _ __ _   _  *
+//* | __/ _ Y __| __|   / _` | | | |/ _ \ '__| | | | *
+//* | ||  __|__ \ |_   | (_| | |_| |  __/ |  | |_| | *
+//*  \__\___|___/\__|___\__, |\__,_|\___|_|   \__, | *
+//*                |_____| |_|                |___/  *
+//===----------------------------------------------------------------------===//
+// Distributed under the MIT License.
+// See https://github.com/paulhuggett/uri/blob/main/LICENSE for information.
+// SPDX-License-Identifier: MIT
+//===----------------------------------------------------------------------===//
+#include "uri/query.hpp"
+
+// google test/fuzz.
+#include "gmock/gmock.h"
+#if URI_FUZZTEST
+#include "fuzztest/fuzztest.h"
+#endif
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "uri/uri.hpp"
+
+using namespace std::string_view_literals;
+using testing::ElementsAre;
+
+namespace {
+
+std::vector<uri::query_param> params (std::string_view const q) {
+  uri::query_params const p{q};
+  return {p.begin (), p.end ()};
+}
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST (QueryParams, Empty) {
+  EXPECT_THAT (params (""sv), ElementsAre ());
+  EXPECT_THAT (params ("&&"sv), ElementsAre ());
+  uri::query_params const absent{std::optional<std::string_view>{}};
+  EXPECT_EQ (absent.begin (), absent.end ());
+}
+
+// NOLINTNEXTLINE
+TEST (QueryParams, Pairs) {
+  EXPECT_THAT (params ("a=1&b=2"sv),
+               ElementsAre (uri::query_param{"a"sv, "1"sv},
+                            uri::query_param{"b"sv, "2"sv}));
+  // Empty pairs are skipped. A pair without '=' has an empty value. Only the
+  // first '=' separates the key from the value.
+  EXPECT_THAT (params ("&a&&b=&c=x=y&"sv),
+               ElementsAre (uri::query_param{"a"sv, ""sv},
+                            uri::query_param{"b"sv, ""sv},
+                            uri::query_param{"c"sv, "x=y"sv}));
+  // Multiple values for the same key are all produced, in order.
+  EXPECT_THAT (params ("k=1&k=2"sv),
+               ElementsAre (uri::query_param{"k"sv, "1"sv},
+                            uri::query_param{"k"sv, "2"sv}));
+  // A lone '=' is not an empty pair: it has an empty key and value.
+  EXPECT_THAT (params ("&=&"sv), ElementsAre (uri::query_param{""sv, ""sv}));
+}
+
+// NOLINTNEXTLINE
+TEST (QueryParams, FromString) {
+  // Constructing from a std::string must not be ambiguous between the
+  // string_view and optional<string_view> constructors.
+  std::string const q = "a=1";
+  uri::query_params const p{q};
+  EXPECT_THAT (std::vector<uri::query_param> (p.begin (), p.end ()),
+               ElementsAre (uri::query_param{"a"sv, "1"sv}));
+}
+
+// NOLINTNEXTLINE
+TEST (QueryParams, ViewsOfInput) {
+  auto const q = "key=a+b%21"sv;
+  auto const p = params (q);
+  ASSERT_EQ (p.size (), 1U);
+  EXPECT_EQ (p[0].key.data (), q.data ());
+  EXPECT_EQ (p[0].value.data (), q.data () + 4);
+  EXPECT_EQ (p[0].value, "a+b%21"sv);
+}
+
+// NOLINTNEXTLINE
+TEST (QueryParams, FromParts) {
+  auto const p = uri::split ("http://example.com/path?x=1&y=%20#frag"sv);
+  ASSERT_TRUE (p.has_value ());
+  EXPECT_THAT (params (*p->query),
+               ElementsAre (uri::query_param{"x"sv, "1"sv},
+                            uri::query_param{"y"sv, "%20"sv}));
+#if defined(__cpp_lib_ranges) && __cpp_lib_ranges >= 201811L
+  static_assert (std::ranges::forward_range<uri::query_params>);
+  static_assert (std::ranges::borrowed_range<uri::query_params>);
+#endif  // __cpp_lib_ranges
+}
+
+// NOLINTNEXTLINE
+TEST (FormDecode, NoDecodingNeeded) {
+  std::string buffer = "untouched";
+  auto const s = "plain"sv;
+  auto const decoded = uri::form_decode (s, buffer);
+  EXPECT_EQ (decoded.data (), s.data ());
+  EXPECT_EQ (buffer, "untouched");
+  EXPECT_FALSE (uri::needs_form_decode (s));
+}
+
+// NOLINTNEXTLINE
+TEST (FormDecode, Decode) {
+  std::string buffer;
+  EXPECT_EQ (uri::form_decode ("a+b"sv, buffer), "a b");
+  EXPECT_EQ (uri::form_decode ("a%2Bb"sv, buffer), "a+b");
+  EXPECT_EQ (uri::form_decode ("%41+%zz"sv, buffer), "A %zz");
+
+  uri::query_param const p{"first+name"sv, "J%C3%B6rg"sv};
+  std::string key_buffer;
+  std::string value_buffer;
+  EXPECT_EQ (p.decoded_key (key_buffer), "first name");
+  EXPECT_EQ (p.decoded_value (value_buffer), "J\xC3\xB6rg");
+}
+
+// NOLINTNEXTLINE
+TEST (QueryIndex, Empty) {
+  uri::query_index const index{""sv};
+  EXPECT_TRUE (index.empty ());
+  EXPECT_EQ (index.find ("a"sv), std::nullopt);
+  EXPECT_TRUE (index.values ("a"sv).empty ());
+  EXPECT_FALSE (index.contains (""sv));
+
+  uri::query_index const absent{std::optional<std::string_view>{}};
+  EXPECT_TRUE (absent.empty ());
+}
+
+// NOLINTNEXTLINE
+TEST (QueryIndex, Find) {
+  uri::query_index const index{"a=1&b=2&c&d="sv};
+  EXPECT_EQ (index.size (), 4U);
+  EXPECT_EQ (index.find ("a"sv), "1"sv);
+  EXPECT_EQ (index.find ("b"sv), "2"sv);
+  EXPECT_EQ (index.find ("c"sv), ""sv);
+  EXPECT_EQ (index.find ("d"sv), ""sv);
+  EXPECT_EQ (index.find ("e"sv), std::nullopt);
+  EXPECT_EQ (index[1], (uri::query_param{"b"sv, "2"sv}));
+}
+
+// NOLINTNEXTLINE
+TEST (QueryIndex, MultipleValues) {
+  uri::query_index const index{"k=1&x=0&k=2&k=3"sv};
+  EXPECT_EQ (index.find ("k"sv), "1"sv);
+  EXPECT_EQ (index.count ("k"sv), 3U);
+  EXPECT_EQ (index.count ("x"sv), 1U);
+  EXPECT_EQ (index.count ("y"sv), 0U);
+  auto const v = index.values ("k"sv);
+  EXPECT_THAT (std::vector<std::string_view> (v.begin (), v.end ()),
+               ElementsAre ("1"sv, "2"sv, "3"sv));
+}
+
+// NOLINTNEXTLINE
+TEST (QueryIndex, DecodedKeys) {
+  uri::query_index index{"first+name=J%C3%B6rg&a%26b=1&first%20name=2"sv};
+  EXPECT_EQ (index.find ("first name"sv), "J%C3%B6rg"sv);
+  EXPECT_EQ (index.count ("first name"sv), 2U);
+  EXPECT_EQ (index.find ("a&b"sv), "1"sv);
+  EXPECT_FALSE (index.contains ("first+name"sv));
+
+  // Moving the index preserves the decoded keys.
+  uri::query_index const moved = std::move (index);
+  EXPECT_EQ (moved.find ("a&b"sv), "1"sv);
+}
+
+// NOLINTNEXTLINE
+TEST (QueryIndex, Large) {
+  // More pairs than fit in the inline storage.
+  std::string query;
+  for (auto ctr = 0U; ctr < 200U; ++ctr) {
+    query += "key" + std::to_string (ctr % 150U) + '=' + std::to_string (ctr) +
+             '&';
+  }
+  uri::query_index const index{query};
+  EXPECT_EQ (index.size (), 200U);
+  for (auto ctr = 0U; ctr < 150U; ++ctr) {
+    auto const key = "key" + std::to_string (ctr);
+    EXPECT_EQ (index.find (key), std::to_string (ctr)) << key;
+    EXPECT_EQ (index.count (key), ctr < 50U ? 2U : 1U) << key;
+  }
+  EXPECT_FALSE (index.contains ("key150"sv));
+}
+
+// NOLINTNEXTLINE
+TEST (QueryIndex, MovedFromIsEmpty) {
+  std::string query;
+  for (auto ctr = 0U; ctr < 20U; ++ctr) {
+    query += "k" + std::to_string (ctr) + "=v&";
+  }
+  uri::query_index index{query};
+  uri::query_index const moved = std::move (index);
+  EXPECT_EQ (moved.size (), 20U);
+  EXPECT_TRUE (moved.contains ("k19"sv));
+  // The source is left as an empty index.
+  // NOLINTNEXTLINE(bugprone-use-after-move)
+  EXPECT_TRUE (index.empty ());
+  // NOLINTNEXTLINE(bugprone-use-after-move)
+  EXPECT_FALSE (index.contains ("zz"sv));
+
+  // Move assignment leaves its source empty too.
+  uri::query_index assigned{"a=1"sv};
+  assigned = std::move (index);
+  EXPECT_TRUE (assigned.empty ());
+  index = uri::query_index{query};
+  EXPECT_EQ (index.find ("k3"sv), "v"sv);
+}
+
+#if URI_FUZZTEST
+static void QueryParamsReassemble (std::string const& input) {
+  // Joining the pairs with '&' should give the input without its empty
+  // pairs.
+  std::string joined;
+  for (auto const& p : uri::query_params{input}) {
+    if (!joined.empty ()) {
+      joined += '&';
+    }
+    joined += p.key;
+    if (p.value.data () == p.key.data () + p.key.length () + 1) {
+      joined += '=';
+      joined += p.value;
+    } else {
+      // The pair had no '='. Its text cannot be empty since empty pairs are
+      // skipped.
+      EXPECT_FALSE (p.key.empty ());
+      EXPECT_TRUE (p.value.empty ());
+    }
+  }
+  std::string expected;
+  for (auto const c : input) {
+    if (c != '&' || (!expected.empty () && expected.back () != '&')) {
+      expected += c;
+    }
+  }
+  if (!expected.empty () && expected.back () == '&') {
+    expected.pop_back ();
+  }
+  EXPECT_EQ (joined, expected);
+}
+FUZZ_TEST (QueryFuzz, QueryParamsReassemble);
+
+static void QueryIndexMatchesParams (std::string const& input) {
+  uri::query_index const index{input};
+  std::string buffer;
+  for (auto const& p : uri::query_params{input}) {
+    auto const key = std::string{p.decoded_key (buffer)};
+    auto const v = index.values (key);
+    EXPECT_NE (std::find (v.begin (), v.end (), p.value), v.end ());
+  }
+}
+FUZZ_TEST (QueryFuzz, QueryIndexMatchesParams);
+#endif  // URI_FUZZTEST
@@ -12,10 +12,12 @@
 //===----------------------------------------------------------------------===//
 #include <gmock/gmock.h>
 
+#include <sstream>
 #include <string>
 #include <vector>
 
 #include "uri/rule.hpp"
+#include "uri/trace.hpp"
 
 using namespace std::string_literals;
 
@@ -169,3 +171,182 @@ TEST_F (Rule, OptionalNotPresent) {
   EXPECT_TRUE (ok);
   EXPECT_THAT (output, ElementsAre ("a", "c"));
 }
+// NOLINTNEXTLINE
+TEST (RuleTrace, Counters) {
+  uri::trace::reset ();
+  uri::trace::enable ();
+  auto const a = [] (rule const& r) {
+    return r.concat ([] (rule const& r1) { return r1.single_char ('a'); })
+      .matched ("a", r);
+  };
+  bool const ok = rule ("aab").star (a).concat (a).done ();
+  uri::trace::enable (false);
+  EXPECT_FALSE (ok);
+  // Nothing is recorded once counting has stopped.
+  EXPECT_TRUE (rule ("a").concat (a).done ());
+
+  auto const snapshot = uri::trace::snapshot ();
+  if constexpr (!uri::trace::available) {
+    EXPECT_TRUE (snapshot.empty ());
+  } else {
+    uri::trace::counters expected;
+    expected.attempts = 4;  // "a", "a", "b" (fails), then "b" (fails).
+    expected.successes = 2;
+    expected.failures = 2;
+    expected.bytes = 2;
+    ASSERT_EQ (snapshot.size (), 1U);
+    EXPECT_EQ (snapshot[0].first, "a");
+    EXPECT_EQ (snapshot[0].second, expected);
+
+    std::ostringstream json;
+    uri::trace::write_json (json);
+    EXPECT_EQ (json.str (),
+               "[\n  {\"production\": \"a\", \"attempts\": 4, "
+               "\"successes\": 2, \"failures\": 2, \"bytes\": 2}\n]\n");
+  }
+  uri::trace::reset ();
+  EXPECT_TRUE (uri::trace::snapshot ().empty ());
+}
+
+namespace {
+
+int digits_calls = 0;
+
+// digits = 1*DIGIT
+rule::matched_result digits (rule const& r) {
+  ++digits_calls;
+  return r.star (uri::digit, 1U).matched ("digits", r);
+}
+
+// A grammar in which every alternative begins with the same production:
+// number = digits "x" / digits "y" / digits
+template <typename Digits>
+auto number (std::vector<std::string>& output, Digits d) {
+  auto const remember = [&output] (std::string_view str) {
+    output.emplace_back (str);
+  };
+  return [=] (rule const& r) {
+    return r
+      .alternative (
+        [=] (rule const& r1) {
+          return r1.concat (d, remember)
+            .concat (single_char ('x'))
+            .matched ("digits \"x\"", r1);
+        },
+        [=] (rule const& r2) {
+          return r2.concat (d, remember)
+            .concat (single_char ('y'))
+            .matched ("digits \"y\"", r2);
+        },
+        [=] (rule const& r3) {
+          return r3.concat (d, remember).matched ("digits", r3);
+        })
+      .matched ("number", r);
+  };
+}
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST_F (Rule, MemoizedAlternatives) {
+  digits_calls = 0;
+  EXPECT_TRUE (rule{"123"}.concat (number (output, digits)).done ());
+  EXPECT_EQ (digits_calls, 3);
+  EXPECT_THAT (output, ElementsAre ("123"));
+
+  digits_calls = 0;
+  output.clear ();
+  uri::fixed_memo_table<16> memo;
+  EXPECT_TRUE (rule ("123", memo)
+                 .concat (number (output, uri::memoized<digits>))
+                 .done ());
+  EXPECT_EQ (digits_calls, 1);
+  EXPECT_EQ (memo.misses (), 1U);
+  EXPECT_EQ (memo.hits (), 2U);
+  // The acceptors of the alternative which matched run just once.
+  EXPECT_THAT (output, ElementsAre ("123"));
+}
+// NOLINTNEXTLINE
+TEST_F (Rule, MemoizedFailure) {
+  digits_calls = 0;
+  uri::fixed_memo_table<16> memo;
+  EXPECT_FALSE (rule ("a", memo)
+                  .concat (number (output, uri::memoized<digits>))
+                  .done ());
+  EXPECT_EQ (digits_calls, 1);
+  EXPECT_TRUE (output.empty ());
+
+  // A new parse with the same table starts afresh.
+  digits_calls = 0;
+  EXPECT_TRUE (rule ("1y", memo)
+                 .concat (number (output, uri::memoized<digits>))
+                 .done ());
+  EXPECT_EQ (digits_calls, 1);
+  EXPECT_THAT (output, ElementsAre ("1"));
+}
+namespace {
+
+int accepted = 0;
+
+// A production which carries an acceptor.
+rule::matched_result counted_digits (rule const& r) {
+  return r.concat (digits, [] (std::string_view) { ++accepted; })
+    .matched ("counted-digits", r);
+}
+
+}  // end anonymous namespace
+
+// NOLINTNEXTLINE
+TEST_F (Rule, MemoizedAcceptors) {
+  digits_calls = 0;
+  accepted = 0;
+  uri::fixed_memo_table<16> memo;
+  EXPECT_TRUE (rule ("1", memo)
+                 .concat (number (output, uri::memoized<counted_digits>))
+                 .done ());
+  EXPECT_EQ (digits_calls, 1);
+  EXPECT_EQ (accepted, 1);
+}
+// NOLINTNEXTLINE
+TEST_F (Rule, MemoFull) {
+  // There is no room for acceptors so results with acceptors are not recorded
+  // but the parse is unaffected.
+  digits_calls = 0;
+  accepted = 0;
+  uri::fixed_memo_table<16, 0> memo;
+  EXPECT_TRUE (rule ("1", memo)
+                 .concat (number (output, uri::memoized<counted_digits>))
+                 .done ());
+  EXPECT_EQ (digits_calls, 3);
+  EXPECT_EQ (accepted, 1);
+  EXPECT_THAT (output, ElementsAre ("1"));
+}
+
+// NOLINTNEXTLINE
+TEST (RuleFurthestFailure, NamesInnermostProduction) {
+  // ab = "a" "b"
+  auto const ab = [] (rule const& r) {
+    return r.concat (single_char ('a'))
+      .concat (single_char ('b'))
+      .matched ("ab", r);
+  };
+  // abc = ab "c"
+  auto const abc = [&ab] (rule const& r) {
+    return r.concat (ab).concat (single_char ('c')).matched ("abc", r);
+  };
+  // x = "x"
+  auto const x = [] (rule const& r) {
+    return r.concat (single_char ('x')).matched ("x", r);
+  };
+
+  std::string_view const in = "abd";
+  uri::furthest_failure failure;
+  EXPECT_FALSE ((rule{in, failure}.alternative (abc, x).done ()));
+  EXPECT_EQ (failure.position (), in.data () + 2);
+  ASSERT_NE (failure.production (), nullptr);
+  EXPECT_STREQ (failure.production (), "abc");
+
+  // A parse started without the record does not update it.
+  EXPECT_FALSE (rule{"xyz"}.alternative (abc, x).done ());
+  EXPECT_EQ (failure.position (), in.data () + 2);
+}
@@ -87,6 +87,17 @@ TEST (UriSplit, EmptyPathComponents) {
   EXPECT_FALSE (x->query);
   EXPECT_FALSE (x->fragment);
 }
+// NOLINTNEXTLINE
+TEST (UriSplit, IPvFutureUpperCaseV) {
+  // ABNF string literals are case-insensitive so IPvFuture's "v" may also be
+  // written as "V".
+  std::optional<uri::parts> const x = uri::split ("http://[V1.x]/");
+  ASSERT_TRUE (x);
+  ASSERT_TRUE (x->authority);
+  EXPECT_EQ (x->authority->host, "[V1.x]");
+  EXPECT_TRUE (x->path.absolute);
+  EXPECT_FALSE (uri::split ("http://[W1.x]/"));
+}
 
 // NOLINTNEXTLINE
 TEST (UriSplit, 0001) {
@@ -1336,6 +1347,262 @@ static void UriSplitNeverCrashes (std::string const& input) {
 FUZZ_TEST (UriSplitFuzz, UriSplitNeverCrashes);
 #endif  // URI_FUZZTEST
 
+// NOLINTNEXTLINE
+TEST (UriSplitWithDiagnostics, Valid) {
+  auto const in = "https://user@example.com:443/a/b?q#f"sv;
+  auto const r = uri::split_with_diagnostics (in);
+  ASSERT_TRUE (std::holds_alternative<uri::parts> (r));
+  EXPECT_EQ (std::get<uri::parts> (r), uri::split (in));
+}
+// NOLINTNEXTLINE
+TEST (UriSplitWithDiagnostics, BadPathCharacter) {
+  // The first of the alternatives of pchar is the innermost production to
+  // fail at the space.
+  auto const r = uri::split_with_diagnostics ("http://h/a b");
+  ASSERT_TRUE (std::holds_alternative<uri::split_error> (r));
+  EXPECT_EQ (std::get<uri::split_error> (r),
+             (uri::split_error{10U, "unreserved"}));
+}
+// NOLINTNEXTLINE
+TEST (UriSplitWithDiagnostics, TruncatedPercentEncoding) {
+  auto const r = uri::split_with_diagnostics ("http://a/b%2");
+  ASSERT_TRUE (std::holds_alternative<uri::split_error> (r));
+  EXPECT_EQ (std::get<uri::split_error> (r),
+             (uri::split_error{12U, "pct-encoded"}));
+}
+// NOLINTNEXTLINE
+TEST (UriSplitWithDiagnostics, BadIPv6Address) {
+  auto const r = uri::split_with_diagnostics ("http://[::g]/");
+  ASSERT_TRUE (std::holds_alternative<uri::split_error> (r));
+  EXPECT_EQ (std::get<uri::split_error> (r), (uri::split_error{10U, "h16"}));
+}
+// NOLINTNEXTLINE
+TEST (UriSplitWithDiagnostics, TrailingCharacters) {
+  // The input is a valid URI-reference up to the second "#".
+  auto const r = uri::split_with_diagnostics ("http://h/?a#b#c");
+  ASSERT_TRUE (std::holds_alternative<uri::split_error> (r));
+  EXPECT_EQ (std::get<uri::split_error> (r).offset, 13U);
+}
+
+// NOLINTNEXTLINE
+TEST (UriSplitOptions, MaxLength) {
+  uri::split_options options;
+  options.max_length = 10;
+  EXPECT_TRUE (uri::split ("http://a/b", options).has_value ());
+  EXPECT_FALSE (uri::split ("http://a/bc", options).has_value ());
+}
+// NOLINTNEXTLINE
+TEST (UriSplitOptions, MaxSegments) {
+  uri::split_options options;
+  options.max_segments = 2;
+  for (auto const in : {"http://h/a/b"sv, "/a/b"sv, "a/b"sv, "s:a/b"sv,
+                        "http://h"sv, "/"sv, ""sv}) {
+    auto const actual = uri::split (in, options);
+    ASSERT_TRUE (actual.has_value ()) << in;
+    EXPECT_EQ (*actual, uri::split (in)) << in;
+  }
+  for (auto const in :
+       {"http://h/a/b/"sv, "/a/b/c"sv, "a/b/c"sv, "s:a/b/c?q"sv, "//h///"sv}) {
+    EXPECT_FALSE (uri::split (in, options).has_value ()) << in;
+  }
+
+  options.max_segments = 0;
+  EXPECT_TRUE (uri::split ("http://h?q", options).has_value ());
+  EXPECT_TRUE (uri::split ("s:", options).has_value ());
+  EXPECT_FALSE (uri::split ("http://h/", options).has_value ());
+  EXPECT_FALSE (uri::split ("/", options).has_value ());
+  EXPECT_FALSE (uri::split ("a", options).has_value ());
+}
+// NOLINTNEXTLINE
+TEST (UriSplitOptions, MaxHostLength) {
+  uri::split_options options;
+  options.max_host_length = 11;
+  EXPECT_TRUE (uri::split ("http://u@example.com:80/", options).has_value ());
+  EXPECT_TRUE (uri::split ("http://[::1]/", options).has_value ());
+  EXPECT_FALSE (uri::split ("http://example.comx/", options).has_value ());
+  EXPECT_FALSE (uri::split ("http://[2001:db8::7]/", options).has_value ());
+}
+// NOLINTNEXTLINE
+TEST (UriSplitOptions, MaxQueryLength) {
+  uri::split_options options;
+  options.max_query_length = 3;
+  EXPECT_TRUE (uri::split ("http://h/?a=b#fragment", options).has_value ());
+  EXPECT_TRUE (uri::split ("?a=b", options).has_value ());
+  EXPECT_FALSE (uri::split ("http://h/?a=bc", options).has_value ());
+  EXPECT_FALSE (uri::split ("?a=bc#f", options).has_value ());
+}
+// NOLINTNEXTLINE
+TEST (UriSplitOptions, LimitWithMultiCharacterElements) {
+  // The host and query are matched against input shortened to a little more
+  // than the limit. Elements which straddle the limit must still be seen in
+  // full.
+  uri::split_options options;
+  options.max_host_length = 5;
+  options.max_query_length = 4;
+  EXPECT_TRUE (uri::split ("//[::1]:80/path/segment", options).has_value ());
+  EXPECT_FALSE (uri::split ("//[::12]:80/path/segment", options).has_value ());
+  EXPECT_TRUE (uri::split ("//a%41b/path/segment", options).has_value ());
+  EXPECT_FALSE (uri::split ("//abc%41/path/segment", options).has_value ());
+  EXPECT_TRUE (uri::split ("?a%41#fragment", options).has_value ());
+  EXPECT_FALSE (uri::split ("?ab%41#fragment", options).has_value ());
+  EXPECT_FALSE (uri::split ("?abc%41#fragment", options).has_value ());
+}
+// NOLINTNEXTLINE
+TEST (UriSplitOptions, Diagnostics) {
+  uri::split_options options;
+  options.max_length = 4;
+  EXPECT_EQ (std::get<uri::split_error> (
+               uri::split_with_diagnostics ("http://h/", options)),
+             (uri::split_error{4U, "URI-reference"}));
+}
+
+// NOLINTNEXTLINE
+TEST (RequestTarget, OriginForm) {
+  for (auto const in : {"/"sv, "/a"sv, "/a/b/"sv, "/a//b"sv, "/a:b@c"sv,
+                        "/p%20q?a=b&c=%7e"sv, "/?"sv, "/a?b/c?d"sv}) {
+    auto const t = uri::parse_request_target (in);
+    ASSERT_TRUE (t.has_value ()) << in;
+    EXPECT_EQ (t->form, uri::request_target_form::origin);
+    EXPECT_EQ (t->parts, uri::split (in)) << in;
+  }
+  // Unlike a URI-reference, "//" does not introduce an authority.
+  auto const t = uri::parse_request_target ("//a");
+  ASSERT_TRUE (t.has_value ());
+  EXPECT_TRUE (t->parts.path.absolute);
+  EXPECT_THAT (t->parts.path.segments, testing::ElementsAre ("", "a"));
+  EXPECT_FALSE (t->parts.authority.has_value ());
+
+  for (auto const in : {"/a b"sv, "/a#f"sv, "/a?b#f"sv, "/%4"sv, "/%4g"sv,
+                        "/a?%"sv, "/a?%zz"sv}) {
+    EXPECT_FALSE (uri::parse_request_target (in).has_value ()) << in;
+  }
+}
+// NOLINTNEXTLINE
+TEST (RequestTarget, AbsoluteForm) {
+  auto const in = "http://user@example.com:8080/a/b?c=d"sv;
+  auto const t = uri::parse_request_target (in);
+  ASSERT_TRUE (t.has_value ());
+  EXPECT_EQ (t->form, uri::request_target_form::absolute);
+  EXPECT_EQ (t->parts, uri::split (in));
+  // absolute-URI does not permit a fragment.
+  EXPECT_FALSE (uri::parse_request_target ("http://example.com/#f"));
+}
+// NOLINTNEXTLINE
+TEST (RequestTarget, AuthorityForm) {
+  {
+    auto const t = uri::parse_request_target ("example.com:443");
+    ASSERT_TRUE (t.has_value ());
+    EXPECT_EQ (t->form, uri::request_target_form::authority);
+    EXPECT_FALSE (t->parts.scheme.has_value ());
+    ASSERT_TRUE (t->parts.authority.has_value ());
+    EXPECT_EQ (t->parts.authority->host, "example.com");
+    EXPECT_EQ (t->parts.authority->port, "443");
+    EXPECT_FALSE (t->parts.authority->userinfo.has_value ());
+  }
+  {
+    auto const t = uri::parse_request_target ("[2001:db8::7]:8080");
+    ASSERT_TRUE (t.has_value ());
+    EXPECT_EQ (t->form, uri::request_target_form::authority);
+    ASSERT_TRUE (t->parts.authority.has_value ());
+    EXPECT_EQ (t->parts.authority->host, "[2001:db8::7]");
+    EXPECT_EQ (t->parts.authority->port, "8080");
+  }
+  EXPECT_TRUE (uri::parse_request_target ("192.0.2.16:80").has_value ());
+  // The port is required.
+  EXPECT_FALSE (uri::parse_request_target ("192.0.2.16").has_value ());
+  EXPECT_FALSE (uri::parse_request_target ("user@example.com:443"));
+}
+// NOLINTNEXTLINE
+TEST (RequestTarget, AsteriskForm) {
+  auto const t = uri::parse_request_target ("*");
+  ASSERT_TRUE (t.has_value ());
+  EXPECT_EQ (t->form, uri::request_target_form::asterisk);
+  EXPECT_THAT (t->parts.path.segments, testing::ElementsAre ("*"));
+  EXPECT_FALSE (uri::parse_request_target ("**").has_value ());
+  EXPECT_FALSE (uri::parse_request_target ("*/").has_value ());
+}
+// NOLINTNEXTLINE
+TEST (RequestTarget, Empty) {
+  EXPECT_FALSE (uri::parse_request_target ("").has_value ());
+}
+// NOLINTNEXTLINE
+TEST (RequestTarget, Limits) {
+  uri::split_options options;
+  options.max_segments = 2;
+  options.max_query_length = 3;
+  EXPECT_TRUE (uri::parse_request_target ("/a/b?c=d", options));
+  EXPECT_FALSE (uri::parse_request_target ("/a/b/c", options));
+  EXPECT_FALSE (uri::parse_request_target ("/a?c=de", options));
+  EXPECT_FALSE (uri::parse_request_target ("http://h/a/b/c", options));
+  options.max_length = 4;
+  EXPECT_FALSE (uri::parse_request_target ("/abcd", options));
+}
+
+#if URI_FUZZTEST
+static void SplitWithDiagnosticsAgrees (std::string const& input) {
+  auto const expected = uri::split (input);
+  auto const actual = uri::split_with_diagnostics (input);
+  if (expected) {
+    ASSERT_TRUE (std::holds_alternative<uri::parts> (actual));
+    EXPECT_EQ (std::get<uri::parts> (actual), *expected);
+  } else {
+    ASSERT_TRUE (std::holds_alternative<uri::split_error> (actual));
+    auto const& error = std::get<uri::split_error> (actual);
+    EXPECT_LE (error.offset, input.size ());
+    EXPECT_FALSE (error.production.empty ());
+  }
+}
+FUZZ_TEST (UriSplitWithDiagnostics, SplitWithDiagnosticsAgrees);
+
+static void SplitOptionsAreLimits (std::string const& input,
+                                   std::size_t max_segments,
+                                   std::size_t max_host_length,
+                                   std::size_t max_query_length) {
+  uri::split_options options;
+  options.max_segments = max_segments % 8;
+  options.max_host_length = max_host_length % 32;
+  options.max_query_length = max_query_length % 32;
+  auto const limited = uri::split (input, options);
+  auto const unlimited = uri::split (input);
+  if (limited) {
+    // Any input accepted with limits must be accepted without them and must
+    // be within those limits.
+    ASSERT_TRUE (unlimited.has_value ());
+    EXPECT_EQ (*limited, *unlimited);
+    EXPECT_LE (limited->path.segments.size (), options.max_segments);
+    EXPECT_LE (limited->query.value_or ("").size (), options.max_query_length);
+    if (limited->authority) {
+      EXPECT_LE (limited->authority->host.size (), options.max_host_length);
+    }
+  } else if (unlimited) {
+    // An input rejected only because of the limits must exceed one of them.
+    auto const& u = *unlimited;
+    EXPECT_TRUE (u.path.segments.size () > options.max_segments ||
+                 u.query.value_or ("").size () > options.max_query_length ||
+                 (u.authority &&
+                  u.authority->host.size () > options.max_host_length));
+  }
+}
+FUZZ_TEST (UriSplitOptions, SplitOptionsAreLimits);
+
+static void OriginFormMatchesSplit (std::string const& path) {
+  // An origin-form target is a URI-reference as long as it does not begin
+  // with "//" (which split() takes to be an authority).
+  auto const in = "/" + path;
+  if (in.find ('#') != std::string::npos || path.substr (0, 1) == "/") {
+    return;
+  }
+  auto const expected = uri::split (in);
+  auto const actual = uri::parse_request_target (in);
+  ASSERT_EQ (actual.has_value (), expected.has_value ());
+  if (actual) {
+    EXPECT_EQ (actual->form, uri::request_target_form::origin);
+    EXPECT_EQ (actual->parts, *expected);
+  }
+}
+FUZZ_TEST (RequestTarget, OriginFormMatchesSplit);
+#endif  // URI_FUZZTEST
+
 // NOLINTNEXTLINE
 TEST (RemoveDotSegments, LeadingDotDotSlash) {
   auto x = uri::split ("../bar");
@@ -1634,6 +1901,78 @@ TEST_F (Join, Abnormal) {
   EXPECT_EQ (uri::split ("http:g"), uri::join (base_, "http:g"));
 }
 
+// NOLINTNEXTLINE
+TEST_F (Join, SingleSegmentBase) {
+  EXPECT_EQ (uri::split ("http://a/g"), uri::join ("http://a/", "g"));
+  EXPECT_EQ (uri::split ("http://a/g"), uri::join ("http://a/b", "g"));
+  EXPECT_EQ (uri::split ("g"), uri::join ("b", "g"));
+}
+
+class MakeRelative : public testing::Test {
+protected:
+  static constexpr std::string_view base_ = "http://a/b/c/d;p?q";
+
+  static std::string relative (std::string_view base, std::string_view target) {
+    auto const r = uri::make_relative (base, target);
+    return r ? uri::compose (*r) : std::string{"(invalid)"};
+  }
+  // Checks that the reference produced by make_relative() is resolved back to
+  // the original target by join().
+  static void round_trip (std::string_view base, std::string_view target) {
+    auto const ref = relative (base, target);
+    EXPECT_EQ (uri::join (base, ref), uri::split (target))
+      << "base=" << base << " target=" << target << " ref=" << ref;
+  }
+};
+
+// NOLINTNEXTLINE
+TEST_F (MakeRelative, Normal) {
+  EXPECT_EQ (relative (base_, "g:h"), "g:h");
+  EXPECT_EQ (relative (base_, "http://a/b/c/g"), "g");
+  EXPECT_EQ (relative (base_, "http://a/b/c/g/"), "g/");
+  EXPECT_EQ (relative (base_, "http://a/g"), "/g");
+  EXPECT_EQ (relative (base_, "http://g"), "//g");
+  EXPECT_EQ (relative (base_, "http://a/b/c/d;p?y"), "?y");
+  EXPECT_EQ (relative (base_, "http://a/b/c/g?y"), "g?y");
+  EXPECT_EQ (relative (base_, "http://a/b/c/d;p?q#s"), "#s");
+  EXPECT_EQ (relative (base_, "http://a/b/c/d;p?q"), "");
+  EXPECT_EQ (relative (base_, "http://a/b/c/d;p"), "d;p");
+  EXPECT_EQ (relative (base_, "http://a/b/c/"), ".");
+  EXPECT_EQ (relative (base_, "http://a/b/"), "../");
+  EXPECT_EQ (relative (base_, "http://a/b/g"), "../g");
+  EXPECT_EQ (relative (base_, "http://a/"), "/");
+  EXPECT_EQ (relative (base_, "https://a/b/c/g"), "https://a/b/c/g");
+}
+
+// NOLINTNEXTLINE
+TEST_F (MakeRelative, Awkward) {
+  // A colon in the first segment must not be mistaken for a scheme.
+  EXPECT_EQ (relative (base_, "http://a/b/c/g:h"), "./g:h");
+  // An empty first segment must not be mistaken for an absolute path.
+  EXPECT_EQ (relative (base_, "http://a/b/c//g"), ".//g");
+  EXPECT_EQ (relative ("http://a/b", "http://a//g"), ".//g");
+  // A path can only be emptied by a network-path reference.
+  EXPECT_EQ (relative (base_, "http://a"), "//a");
+  EXPECT_EQ (relative ("http://a", "http://a/b"), "b");
+  EXPECT_EQ (relative ("http://a", "http://a?q"), "?q");
+}
+
+// NOLINTNEXTLINE
+TEST_F (MakeRelative, RoundTrip) {
+  for (auto const target :
+       {"g:h"sv, "http://a/b/c/g"sv, "http://a/b/c/g/"sv, "http://a/g"sv,
+        "http://g"sv, "http://a/b/c/d;p?y"sv, "http://a/b/c/g?y"sv,
+        "http://a/b/c/d;p?q#s"sv, "http://a/b/c/g#s"sv, "http://a/b/c/;x"sv,
+        "http://a/b/c/d;p"sv, "http://a/b/c/"sv, "http://a/b/"sv,
+        "http://a/"sv, "http://a"sv, "http://a/b/c/g:h"sv, "http://a/b/c//g"sv,
+        "http://a//"sv, "http://a/b/c/d;p/e"sv, "http://u@a:80/b"sv}) {
+    round_trip (base_, target);
+    round_trip ("http://a"sv, target);
+    round_trip ("http://a/"sv, target);
+    round_trip ("http://a/x/y/z/w/v"sv, target);
+  }
+}
+
 using authority = std::optional<struct uri::parts::authority>;
 struct parts_without_authority {
   std::optional<std::string> scheme;